@@ -0,0 +1,210 @@
+#ifndef ADAPTIVE_MESH_H
+#define ADAPTIVE_MESH_H
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <queue>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "vector3D.h"
+
+
+// Adaptive sampling of the field inside a box. The box is covered by
+// base_steps root cells along every axis with non-zero extent (so a flat box
+// gives a quadtree and a full box an octree). A cell is split into 2^d
+// children when the field at its centre differs from the average of its
+// corners by more than tolerance times the largest |B| seen on the cell.
+// The worst cells are split first until all cells are below the tolerance,
+// reach max_depth or the point budget max_points is used up.
+//
+// All points live on a lattice with spacing (extent / base_steps) / 2^max_depth,
+// so corners shared by neighbouring cells are evaluated only once.
+class AdaptiveMesh {
+public:
+	using Field = std::tuple<vector3D, vector3D>;
+	using Evaluator = std::function<Field(const vector3D&)>;
+	using Key = std::array<long long, 3>;
+
+	struct Cell {
+		Key lo;                   // lattice coordinates of the lower corner
+		long long size;           // edge length in lattice units
+		unsigned depth;
+		double error;             // refinement indicator, see class comment
+		std::size_t first_child;  // index of the first child, 0 for leaves
+		unsigned nr_children;
+	};
+
+private:
+	std::array<double, 3> min;
+	std::array<double, 3> spacing;
+	std::array<bool, 3> active;
+	const unsigned max_depth;
+	const std::size_t max_points;
+	const double tolerance;
+
+	std::map<Key, std::size_t> index;
+	std::vector<vector3D> points;
+	std::vector<Field> fields;
+	std::vector<Cell> cells;
+	std::vector<std::size_t> roots;
+
+	vector3D position(const Key& key) const
+	{
+		return vector3D{min[0] + key[0] * spacing[0],
+		                min[1] + key[1] * spacing[1],
+		                min[2] + key[2] * spacing[2]};
+	}
+
+	const Field& node(const Key& key, const Evaluator& evaluate)
+	{
+		auto it = index.find(key);
+		if(it == index.end()) {
+			points.push_back(position(key));
+			fields.push_back(evaluate(points.back()));
+			it = index.emplace(key, fields.size() - 1).first;
+		}
+		return fields[it->second];
+	}
+
+	std::vector<Key> corners(const Cell& cell) const
+	{
+		std::vector<Key> result{cell.lo};
+		for(unsigned axis = 0; axis < 3; axis++) {
+			if(!active[axis]) continue;
+			const std::size_t n = result.size();
+			for(std::size_t i = 0; i < n; i++) {
+				Key key = result[i];
+				key[axis] += cell.size;
+				result.push_back(key);
+			}
+		}
+		return result;
+	}
+
+	Cell make_cell(const Key& lo, long long size, unsigned depth, const Evaluator& evaluate)
+	{
+		Cell cell{lo, size, depth, 0, 0, 0};
+		Key centre = lo;
+		for(unsigned axis = 0; axis < 3; axis++) {
+			if(active[axis]) centre[axis] += size / 2;
+		}
+
+		double bx = 0, by = 0, bz = 0, scale = 0;
+		const std::vector<Key> keys = corners(cell);
+		for(const Key& key : keys) {
+			const vector3D& b = std::get<0>(node(key, evaluate));
+			bx += get<0>(b);
+			by += get<1>(b);
+			bz += get<2>(b);
+			scale = std::max(scale, b.length());
+		}
+		const vector3D& b = std::get<0>(node(centre, evaluate));
+		scale = std::max(scale, b.length());
+		vector3D deviation{get<0>(b) - bx / keys.size(),
+		                   get<1>(b) - by / keys.size(),
+		                   get<2>(b) - bz / keys.size()};
+		cell.error = scale == 0 ? 0 : deviation.length() / scale;
+		return cell;
+	}
+
+public:
+	// extent of the box along each axis is [min_, max_]; axes with
+	// min_ == max_ are not refined
+	AdaptiveMesh(const std::array<double, 3>& min_, const std::array<double, 3>& max_,
+	             std::size_t base_steps, unsigned max_depth_, std::size_t max_points_, double tolerance_)
+		: min(min_), max_depth{max_depth_}, max_points{max_points_}, tolerance{tolerance_}
+	{
+		for(unsigned axis = 0; axis < 3; axis++) {
+			active[axis] = max_[axis] > min_[axis];
+			spacing[axis] = active[axis]
+				? (max_[axis] - min_[axis]) / (base_steps * (1LL << max_depth)) : 0;
+		}
+		std::array<std::size_t, 3> nr_roots;
+		for(unsigned axis = 0; axis < 3; axis++)
+			nr_roots[axis] = active[axis] ? base_steps : 1;
+		for(std::size_t i = 0; i < nr_roots[0]; i++) {
+			for(std::size_t j = 0; j < nr_roots[1]; j++) {
+				for(std::size_t k = 0; k < nr_roots[2]; k++) {
+					const Key lo{{static_cast<long long>(i) << max_depth,
+					              static_cast<long long>(j) << max_depth,
+					              static_cast<long long>(k) << max_depth}};
+					roots.push_back(cells.size());
+					cells.push_back(Cell{lo, 1LL << max_depth, 0, 0, 0, 0});
+				}
+			}
+		}
+	}
+
+	// samples the field, refining the worst cells first
+	void refine(const Evaluator& evaluate)
+	{
+		using Item = std::pair<double, std::size_t>;
+		std::priority_queue<Item> queue;
+		for(std::size_t i : roots) {
+			cells[i] = make_cell(cells[i].lo, cells[i].size, 0, evaluate);
+			queue.push(Item{cells[i].error, i});
+		}
+
+		while(!queue.empty() && points.size() < max_points) {
+			const std::size_t i = queue.top().second;
+			queue.pop();
+			if(cells[i].error <= tolerance) break;
+			if(cells[i].depth == max_depth) continue;
+
+			const Cell parent = cells[i];
+			const long long half = parent.size / 2;
+			std::vector<Key> offsets{parent.lo};
+			for(unsigned axis = 0; axis < 3; axis++) {
+				if(!active[axis]) continue;
+				const std::size_t n = offsets.size();
+				for(std::size_t c = 0; c < n; c++) {
+					Key key = offsets[c];
+					key[axis] += half;
+					offsets.push_back(key);
+				}
+			}
+			cells[i].first_child = cells.size();
+			cells[i].nr_children = offsets.size();
+			for(const Key& lo : offsets) {
+				cells.push_back(make_cell(lo, half, parent.depth + 1, evaluate));
+				queue.push(Item{cells.back().error, cells.size() - 1});
+			}
+		}
+	}
+
+	std::size_t size() const noexcept { return points.size(); }
+	const std::vector<vector3D>& get_points() const noexcept { return points; }
+	const std::vector<Field>& get_fields() const noexcept { return fields; }
+
+	// Hierarchical view: one line per cell in depth-first order, children
+	// directly follow their parent.
+	void write_cells(std::ostream& out) const
+	{
+		out << "#depth\tx_min\tx_max\ty_min\ty_max\tz_min\tz_max\terror\tleaf\n";
+		std::vector<std::size_t> stack(roots.rbegin(), roots.rend());
+		while(!stack.empty()) {
+			const Cell& cell = cells[stack.back()];
+			stack.pop_back();
+			Key hi = cell.lo;
+			for(unsigned axis = 0; axis < 3; axis++) {
+				if(active[axis]) hi[axis] += cell.size;
+			}
+			const vector3D lo_point = position(cell.lo);
+			const vector3D hi_point = position(hi);
+			out << cell.depth
+			    << '\t' << get<0>(lo_point) << '\t' << get<0>(hi_point)
+			    << '\t' << get<1>(lo_point) << '\t' << get<1>(hi_point)
+			    << '\t' << get<2>(lo_point) << '\t' << get<2>(hi_point)
+			    << '\t' << cell.error << '\t' << (cell.nr_children == 0) << '\n';
+			for(unsigned c = cell.nr_children; c > 0; c--)
+				stack.push_back(cell.first_child + c - 1);
+		}
+	}
+};
+
+#endif // ADAPTIVE_MESH_H
@@ -0,0 +1,241 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "field.h"
+#include "quadrature.h"
+#include "configure.h"
+
+
+// Quadrature rule for the points whose distance to the wire lies in
+// [min_distance, max_distance).
+struct AutotuneClass {
+	double min_distance, max_distance;
+	int key;
+};
+
+// Chooses the quadrature rule of every distance class of the grid by timing
+// them all. The grid points that are integrated numerically (not covered by
+// the far field expansions) are split into AUTOTUNE_CLASSES classes of equal
+// size by their distance to the wire; at AUTOTUNE_SAMPLES points of every
+// class each rule integrates the field of every conductor with the settings
+// of scene.quadrature at the point, as evaluate_grid() does but from a cold
+// start (the Gauss-Kronrod rules by a WarmStartIntegrator where the grid uses
+// one). A rule meets the tolerance at a point if it is within
+// rel_error |B| + |abs_error| of a reference integrated to a thousandth of
+// the tolerances; the class gets the fastest rule meeting it at all of its
+// points (its current rule unless another is clearly faster), else the most
+// accurate one. Classes without such points are left out. The table of times
+// and errors is written to report.
+inline std::vector<AutotuneClass> autotune(const Scene& scene, const Range& x_range, const Range& y_range,
+                                           const Range& z_range, std::ostream& report)
+{
+	const int keys[] = {GSL_INTEG_GAUSS15, GSL_INTEG_GAUSS21, GSL_INTEG_GAUSS31, GSL_INTEG_GAUSS41,
+	                    GSL_INTEG_GAUSS51, GSL_INTEG_GAUSS61, QUADRATURE_QAGS, QUADRATURE_CQUAD};
+	const std::size_t nr_rules = sizeof(keys) / sizeof(keys[0]);
+
+	// every conductor alone, set up as for the run
+	std::vector<Scene> units;
+	std::vector<CurveSamples> samples;
+	for(std::size_t c = 0; c < scene.curves.size(); c++) {
+		units.push_back(scene.unit(c));
+		prepare(units.back());
+		samples.emplace_back(*units.back().curves[0]);
+	}
+
+	// (conductor, point) pairs of at most 4096 grid points, by distance
+	struct Sample {
+		std::size_t conductor;
+		vector3D point;
+		double distance;
+	};
+	std::vector<Sample> candidates;
+	const std::size_t n = x_range.nr_steps * y_range.nr_steps * z_range.nr_steps;
+	const std::size_t stride = std::max<std::size_t>(1, n / 4096);
+	for(std::size_t index = 0; index < n; index += stride) {
+		const std::size_t k = index % z_range.nr_steps;
+		const std::size_t j = index / z_range.nr_steps % y_range.nr_steps;
+		const std::size_t i = index / z_range.nr_steps / y_range.nr_steps;
+		for(std::size_t c = 0; c < units.size(); c++) {
+			vector3D point{x_range.at(i), y_range.at(j), z_range.at(k)};
+			const Curve& curve = *units[c].curves[0];
+			if(curve.multipole && curve.multipole->covers(point)) continue;
+			double distance, magnitude;
+			samples[c].estimate(point, distance, magnitude);
+			candidates.push_back(Sample{c, std::move(point), distance});
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(),
+	          [](const Sample& a, const Sample& b) { return a.distance < b.distance; });
+
+	std::vector<double> bounds{0};
+	for(std::size_t i = 1; i < AUTOTUNE_CLASSES && !candidates.empty(); i++)
+		bounds.push_back(candidates[i * candidates.size() / AUTOTUNE_CLASSES].distance);
+	bounds.push_back(std::numeric_limits<double>::max());
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+	// evaluate_grid() only warm starts along the Hilbert curve, and not for
+	// axisymmetric scenes
+	const bool warm_grid = FIELD_GRID_HILBERT && !(FIELD_AXISYMMETRIC && scene.axisymmetric());
+	FieldWorkspace workspace(scene.quadrature.max_limit());
+	FieldWorkspace reference_workspace(10 * scene.quadrature.max_limit());
+	const std::streamsize precision = report.precision(3);
+	std::vector<AutotuneClass> classes;
+	for(std::size_t b = 0; b + 1 < bounds.size(); b++) {
+		const auto first = std::lower_bound(candidates.begin(), candidates.end(), bounds[b],
+		                                    [](const Sample& s, double d) { return s.distance < d; });
+		const auto last = std::lower_bound(first, candidates.end(), bounds[b + 1],
+		                                   [](const Sample& s, double d) { return s.distance < d; });
+		const std::size_t nr_candidates = last - first;
+		std::vector<double> seconds(nr_rules, 0), worst(nr_rules, 0);   // worst error / tolerance
+		std::size_t nr_samples = 0;
+		for(std::size_t s = 0; s < AUTOTUNE_SAMPLES && s < nr_candidates; s++) {
+			const Sample& sample = first[(2*s + 1) * nr_candidates / (2 * std::min<std::size_t>(AUTOTUNE_SAMPLES, nr_candidates))];
+			Curve* curve = units[sample.conductor].curves[0].get();
+			Quadrature quadrature;
+			quadrature.defaults = scene.quadrature.at(sample.distance);
+			quadrature.scaled_abs_error = scene.quadrature.scaled_abs_error;
+
+			Quadrature reference = quadrature;
+			reference.defaults.rel_error *= 1.E-3;
+			reference.defaults.abs_error *= 1.E-3;
+			reference.defaults.key = GSL_INTEG_GAUSS61;
+			reference.defaults.limit *= 10;
+			const std::size_t nr_calls = current_cost().integrand_calls;
+			const vector3D exact = std::get<0>(biot_savart(curve, sample.point, reference_workspace.get(),
+			                                                {{true, true, true}}, nullptr, reference));
+			if(current_cost().integrand_calls == nr_calls) continue;   // not integrated numerically
+			nr_samples++;
+			const double tolerance = quadrature.defaults.rel_error * exact.length()
+				+ std::sqrt(3.) * MU0_4_PI * quadrature_at(quadrature, *curve, sample.point).abs_error;
+
+			for(std::size_t r = 0; r < nr_rules; r++) {
+				quadrature.defaults.key = keys[r];
+				double best = std::numeric_limits<double>::max();
+				vector3D field;
+				for(unsigned repeat = 0; repeat < AUTOTUNE_REPEATS; repeat++) {
+					// the integrators of the grid, without a previous partition
+					std::array<WarmStartIntegrator, 3> warm;
+					const auto start = std::chrono::steady_clock::now();
+					field = std::get<0>(biot_savart(curve, sample.point, workspace.get(), {{true, true, true}},
+					                                warm_grid ? &warm : nullptr, quadrature));
+					best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+				}
+				seconds[r] += best;
+				worst[r] = std::max(worst[r], tolerance > 0 ? (field - exact).length() / tolerance : 0);
+			}
+		}
+		if(nr_samples == 0) continue;
+
+		// the rule scene.quadrature has for the class is only replaced by one
+		// more than timing noise (10 %) faster
+		std::size_t chosen = std::find(keys, keys + nr_rules, scene.quadrature.at(bounds[b]).key) - keys;
+		for(std::size_t r = 0; r < nr_rules; r++) {
+			const bool better = worst[chosen] <= 1 ? worst[r] <= 1 && seconds[r] < 0.9 * seconds[chosen] 
+			                                       : worst[r] < worst[chosen];
+			if(better) chosen = r;
+		}
+		classes.push_back(AutotuneClass{bounds[b], bounds[b + 1], keys[chosen]});
+
+		report << "\tdistance [" << bounds[b] << ", " << bounds[b + 1] << "), " << nr_samples << " point(s):";
+		for(std::size_t r = 0; r < nr_rules; r++) {
+			report << (r % 4 == 0 ? "\n\t\t" : "  ") << rule_name(keys[r]) << ' ' << 1.E6 * seconds[r] / nr_samples
+			       << " us, error/tolerance " << worst[r];
+		}
+		report << "\n\t\tchosen: " << rule_name(keys[chosen]) << "\n";
+	}
+	report.precision(precision);
+	return classes;
+}
+
+// Gives the points of every class the rule of the class, keeping the
+// tolerances and limits quadrature has for them.
+inline void apply_autotune(Quadrature& quadrature, const std::vector<AutotuneClass>& classes)
+{
+	std::vector<QuadratureRegion> regions;
+	for(const AutotuneClass& c : classes) {
+		// the settings of quadrature only change at the boundaries of its regions
+		std::vector<double> bounds{c.min_distance, c.max_distance};
+		for(const QuadratureRegion& region : quadrature.regions) {
+			for(double bound : {region.min_distance, region.max_distance}) {
+				if(bound > c.min_distance && bound < c.max_distance) bounds.push_back(bound);
+			}
+		}
+		std::sort(bounds.begin(), bounds.end());
+		bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+		for(std::size_t b = 0; b + 1 < bounds.size(); b++) {
+			regions.push_back(QuadratureRegion{bounds[b], bounds[b + 1], quadrature.at(bounds[b])});
+			regions.back().settings.key = c.key;
+		}
+	}
+	// points outside the classes keep their settings
+	regions.insert(regions.end(), quadrature.regions.begin(), quadrature.regions.end());
+	quadrature.regions = regions;
+}
+
+// The choices are kept in a text file, one line per configuration: its tag
+// (see FieldBasis::make_tag), the number of classes and the bounds and rule
+// name of every class.
+inline bool load_autotune(const std::string& path, std::uint64_t tag, std::vector<AutotuneClass>& classes)
+{
+	std::ifstream in(path);
+	std::string line;
+	while(std::getline(in, line)) {
+		std::istringstream values(line);
+		std::uint64_t line_tag = 0;
+		std::size_t nr_classes = 0;
+		if(!(values >> line_tag >> nr_classes) || line_tag != tag) continue;
+		std::vector<AutotuneClass> result(nr_classes);
+		for(AutotuneClass& c : result) {
+			std::string rule;
+			values >> c.min_distance >> c.max_distance >> rule;
+			c.key = rule_key(rule);
+			if(c.key == 0) return false;
+		}
+		if(!values) return false;
+		classes = result;
+		return true;
+	}
+	return false;
+}
+
+// Adds or replaces the line of tag.
+inline bool save_autotune(const std::string& path, std::uint64_t tag, const std::vector<AutotuneClass>& classes)
+{
+	std::vector<std::string> lines;
+	{
+		std::ifstream in(path);
+		std::string line;
+		while(std::getline(in, line)) {
+			std::istringstream values(line);
+			std::uint64_t line_tag = 0;
+			if(values >> line_tag && line_tag != tag) lines.push_back(line);
+		}
+	}
+	std::ostringstream line;
+	line.precision(17);
+	line << tag << ' ' << classes.size();
+	for(const AutotuneClass& c : classes)
+		line << ' ' << c.min_distance << ' ' << c.max_distance << ' ' << rule_name(c.key);
+	lines.push_back(line.str());
+
+	std::ofstream out(path);
+	for(const std::string& l : lines) out << l << '\n';
+	return out.good();
+}
+
+#endif // AUTOTUNE_H
@@ -0,0 +1,230 @@
+#ifndef BARNES_HUT_H
+#define BARNES_HUT_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+extern "C" {
+	#include <gsl/gsl_integration.h>
+}
+
+#include "vector3D.h"
+#include "multipole.h"
+#include "straight_segments.h"
+
+
+// Barnes-Hut tree code over the straight segments of a piecewise straight
+// curve. Segments are sorted into a binary tree by recursive median splits
+// along the longest side of their bounding box. Every node stores the
+// Cartesian moments (see TaylorTable) of its segments about the centre of its
+// bounding sphere.
+//
+// A node whose bounding sphere radius is below theta times the distance to
+// the point is evaluated from its moments, leaves that are too close are
+// summed exactly with straight_segments_field(). theta follows from the
+// requested accuracy as theta^(order + 1) = rel_error.
+//
+// Results are in the same (unscaled) units as the quadrature in biot_savart.
+class BarnesHutTree {
+private:
+	struct Node {
+		std::array<double, 3> centre;
+		double radius;
+		std::size_t begin, end;                // range of segments
+		std::array<std::size_t, 2> children;   // both 0 for leaves
+	};
+
+	TaylorTable table;
+	double theta;
+	double rel_error, abs_error;
+	double current, wireR;
+	std::size_t leaf_size;
+	std::vector<double> ax, ay, az, bx, by, bz;  // segments in tree order
+	std::vector<Node> nodes;
+	std::vector<double> moments;                 // 3 * table.nr_moments() per node
+
+	double midpoint(std::size_t i, unsigned axis) const noexcept
+	{
+		switch(axis) {
+			case 0: return ax[i] + bx[i];
+			case 1: return ay[i] + by[i];
+			default: return az[i] + bz[i];
+		}
+	}
+
+	std::size_t build(std::vector<std::size_t>& order, std::size_t begin, std::size_t end)
+	{
+		std::array<double, 3> lo{{HUGE_VAL, HUGE_VAL, HUGE_VAL}};
+		std::array<double, 3> hi{{-HUGE_VAL, -HUGE_VAL, -HUGE_VAL}};
+		for(std::size_t n = begin; n < end; n++) {
+			const std::size_t i = order[n];
+			const double ends[2][3] = {{ax[i], ay[i], az[i]}, {bx[i], by[i], bz[i]}};
+			for(const auto& e : ends) {
+				for(unsigned k = 0; k < 3; k++) {
+					lo[k] = std::min(lo[k], e[k]);
+					hi[k] = std::max(hi[k], e[k]);
+				}
+			}
+		}
+
+		Node node;
+		node.begin = begin;
+		node.end = end;
+		node.children = {{0, 0}};
+		node.radius = 0;
+		for(unsigned k = 0; k < 3; k++) node.centre[k] = (lo[k] + hi[k]) / 2;
+		for(std::size_t n = begin; n < end; n++) {
+			const std::size_t i = order[n];
+			const double ends[2][3] = {{ax[i], ay[i], az[i]}, {bx[i], by[i], bz[i]}};
+			for(const auto& e : ends) {
+				const double dx = e[0] - node.centre[0];
+				const double dy = e[1] - node.centre[1];
+				const double dz = e[2] - node.centre[2];
+				node.radius = std::max(node.radius, std::sqrt(dx*dx + dy*dy + dz*dz));
+			}
+		}
+		node.radius += wireR;
+
+		const std::size_t index = nodes.size();
+		nodes.push_back(node);
+		if(end - begin > leaf_size) {
+			unsigned axis = 0;
+			for(unsigned k = 1; k < 3; k++) {
+				if(hi[k] - lo[k] > hi[axis] - lo[axis]) axis = k;
+			}
+			const std::size_t mid = (begin + end) / 2;
+			std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+			                 [this, axis](std::size_t i, std::size_t j) {
+			                 	return midpoint(i, axis) < midpoint(j, axis);
+			                 });
+			const std::size_t left = build(order, begin, mid);
+			const std::size_t right = build(order, mid, end);
+			nodes[index].children = {{left, right}};
+		}
+		return index;
+	}
+
+	void sum(const double p[3], double opening, double b[3], double err[3]) const
+	{
+		const std::size_t stride = 3 * table.nr_moments();
+		for(unsigned k = 0; k < 3; k++) b[k] = err[k] = 0;
+
+		std::vector<std::size_t> stack{0};
+		while(!stack.empty()) {
+			const std::size_t n = stack.back();
+			const Node& node = nodes[n];
+			stack.pop_back();
+
+			const double R[3] = {p[0] - node.centre[0], p[1] - node.centre[1], p[2] - node.centre[2]};
+			const double d = std::sqrt(R[0]*R[0] + R[1]*R[1] + R[2]*R[2]);
+			double nb[3], ne[3];
+			if(node.radius < opening * d) {
+				table.field(&moments[n * stride], R, nb, ne);
+				const double ratio = node.radius / d;
+				const double tail = ratio / (1 - ratio);
+				for(unsigned k = 0; k < 3; k++) {
+					b[k] += nb[k];
+					err[k] += tail * std::abs(ne[k]);
+				}
+			} else if(node.children[0] == 0) {
+				const std::size_t i = node.begin;
+				straight_segments_field(&ax[i], &ay[i], &az[i], &bx[i], &by[i], &bz[i],
+				                        node.end - i, p, wireR, nb, ne);
+				for(unsigned k = 0; k < 3; k++) {
+					b[k] += current * nb[k];
+					err[k] += std::abs(current) * ne[k];
+				}
+			} else {
+				stack.push_back(node.children[1]);
+				stack.push_back(node.children[0]);
+			}
+		}
+	}
+
+	static void permute(std::vector<double>& v, const std::vector<std::size_t>& order)
+	{
+		std::vector<double> result(order.size());
+		for(std::size_t n = 0; n < order.size(); n++) result[n] = v[order[n]];
+		v.swap(result);
+	}
+
+public:
+	// The segments are the pieces of the curve between consecutive
+	// breakpoints, which must be straight.
+	template<class CurveType>
+	BarnesHutTree(const CurveType& curve, double rel_error_, double abs_error_,
+	              unsigned order_, std::size_t leaf_size_)
+		: table{order_}, theta{std::pow(rel_error_, 1.0 / (order_ + 1))},
+		  rel_error{rel_error_}, abs_error{abs_error_},
+		  current{curve.current}, wireR{curve.wireR}, leaf_size{leaf_size_}
+	{
+		const std::vector<double> ts = curve.breakpoints();
+		for(std::size_t i = 0; i + 1 < ts.size(); i++) {
+			const vector3D a = curve.parametrize(ts[i]);
+			const vector3D b = curve.parametrize(ts[i+1]);
+			ax.push_back(get<0>(a)); ay.push_back(get<1>(a)); az.push_back(get<2>(a));
+			bx.push_back(get<0>(b)); by.push_back(get<1>(b)); bz.push_back(get<2>(b));
+		}
+
+		std::vector<std::size_t> order(ax.size());
+		std::iota(order.begin(), order.end(), 0);
+		build(order, 0, order.size());
+		for(std::vector<double>* v : {&ax, &ay, &az, &bx, &by, &bz}) permute(*v, order);
+
+		// the moments are polynomials of degree order in the position along
+		// a segment, so order/2 + 1 Gauss-Legendre points are exact
+		const std::size_t nr_points = table.get_order() / 2 + 1;
+		gsl_integration_glfixed_table* gl = gsl_integration_glfixed_table_alloc(nr_points);
+		std::vector<double> us(nr_points), ws(nr_points);
+		for(std::size_t k = 0; k < nr_points; k++)
+			gsl_integration_glfixed_point(0, 1, k, &us[k], &ws[k], gl);
+		gsl_integration_glfixed_table_free(gl);
+
+		const std::size_t stride = 3 * table.nr_moments();
+		moments.assign(nodes.size() * stride, 0);
+		for(std::size_t n = 0; n < nodes.size(); n++) {
+			const Node& node = nodes[n];
+			for(std::size_t i = node.begin; i < node.end; i++) {
+				const double l[3] = {bx[i] - ax[i], by[i] - ay[i], bz[i] - az[i]};
+				for(std::size_t k = 0; k < nr_points; k++) {
+					const double s[3] = {ax[i] + us[k] * l[0] - node.centre[0],
+					                     ay[i] + us[k] * l[1] - node.centre[1],
+					                     az[i] + us[k] * l[2] - node.centre[2]};
+					const double w[3] = {current * ws[k] * l[0], current * ws[k] * l[1], current * ws[k] * l[2]};
+					table.accumulate(s, w, &moments[n * stride]);
+				}
+			}
+		}
+	}
+
+	std::size_t size() const noexcept { return nodes.size(); }
+	double get_theta() const noexcept { return theta; }
+
+	// Same contract as MultipoleExpansion::evaluate(): the error is the sum of
+	// the truncation estimates of the nodes evaluated from their moments and
+	// the rounding bound of the exact part. If it does not meet the
+	// tolerances the sum is repeated with theta halved, at most max_retries
+	// times, before giving up and returning false with field untouched.
+	bool evaluate(const vector3D& point, std::tuple<vector3D, vector3D>& field, 
+	              unsigned max_retries = 2) const
+	{
+		const double p[3] = {get<0>(point), get<1>(point), get<2>(point)};
+		for(unsigned retry = 0; retry <= max_retries; retry++) {
+			double b[3], err[3];
+			sum(p, std::ldexp(theta, -static_cast<int>(retry)), b, err);
+			vector3D result{b[0], b[1], b[2]};
+			vector3D error{err[0], err[1], err[2]};
+			if(error.length() <= std::max(abs_error, rel_error * result.length())) {
+				field = std::tuple<vector3D, vector3D>(std::move(result), std::move(error));
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+#endif // BARNES_HUT_H
@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+	#include <gsl/gsl_errno.h>
+	#include <gsl/gsl_sf_ellint.h>
+}
+
+#include "../gnuplot-iostream.h"
+#include "../field.h"
+
+
+// Accuracy versus cost of the evaluation engines. Every engine runs on the
+// points of every reference case with a ladder of settings; for each run the
+// median and maximum relative error against the analytic field, the
+// integrand evaluations and the wall time per point are written to
+// ACCURACY_DAT and plotted to ACCURACY_EVALUATIONS_PNG and ACCURACY_TIME_PNG.
+
+#define ACCURACY_DAT "accuracy.dat"
+#define ACCURACY_EVALUATIONS_PNG "accuracy_evaluations.png"
+#define ACCURACY_TIME_PNG "accuracy_time.png"
+
+namespace {
+
+	const double radius = 0.01;
+	const double wire_radius = 1.E-6;   // thin wire: the references ignore the wire radius
+	const std::size_t nr_turns = 10;
+	const double length = 0.05;
+
+	// Field of a curve at a set of points known in closed form; only the
+	// components with compare set enter the error.
+	struct ReferenceCase {
+		std::string name;
+		std::shared_ptr<Curve> curve;
+		std::vector<std::array<double, 3>> points;
+		std::vector<std::array<double, 3>> fields;
+		std::array<bool, 3> compare;
+
+		// largest |B| of the case, the unit of the errors (so that zeros of
+		// components do not blow them up)
+		double scale() const
+		{
+			double result = 0;
+			for(const std::array<double, 3>& b : fields)
+				result = std::max(result, std::sqrt(b[0]*b[0] + b[1]*b[1] + b[2]*b[2]));
+			return result;
+		}
+	};
+
+	// on the axis of a circle: B_z = mu0 I R^2 / (2 (R^2 + z^2)^(3/2))
+	ReferenceCase circle_on_axis()
+	{
+		ReferenceCase c{"circle_axis", std::make_shared<Circle>(radius, 1, wire_radius), {}, {}, {{true, true, true}}};
+		for(int i = 0; i < 50; i++) {
+			const double z = -5 * radius + i * 10 * radius / 49;
+			c.points.push_back({{0, 0, z}});
+			c.fields.push_back({{0, 0, 2 * M_PI * MU0_4_PI * radius * radius / std::pow(radius * radius + z * z, 1.5)}});
+		}
+		return c;
+	}
+
+	// On the axis of the helix (R cos t, R sin t, c t), |t| <= period/2, the
+	// integrand of B_z is R^2 / (R^2 + (z - c t)^2)^(3/2), which integrates
+	// to the finite solenoid formula. B_x and B_y do not vanish on the axis
+	// of a helix and are not compared.
+	ReferenceCase coil_on_axis()
+	{
+		ReferenceCase c{"coil_axis", std::make_shared<Coil>(radius, 1, nr_turns, length, wire_radius), {}, {},
+		                {{false, false, true}}};
+		const double period = nr_turns * 2 * M_PI;
+		const double pitch = length / period;
+		for(int i = 0; i < 50; i++) {
+			const double z = -length + i * 2 * length / 49;
+			const double u1 = z + pitch * period / 2, u2 = z - pitch * period / 2;
+			c.points.push_back({{0, 0, z}});
+			c.fields.push_back({{0, 0, MU0_4_PI / pitch * (u1 / std::sqrt(radius * radius + u1 * u1)
+			                                               - u2 / std::sqrt(radius * radius + u2 * u2))}});
+		}
+		return c;
+	}
+
+	// Field of a circular loop anywhere, from the complete elliptic integrals
+	// K and E of modulus k, k^2 = 4 R rho / ((R + rho)^2 + z^2).
+	std::array<double, 3> loop_field(double x, double y, double z)
+	{
+		const double rho = std::hypot(x, y);
+		const double a2 = (radius + rho) * (radius + rho) + z * z;
+		const double b2 = (radius - rho) * (radius - rho) + z * z;
+		const double k = std::sqrt(4 * radius * rho / a2);
+		const double K = gsl_sf_ellint_Kcomp(k, GSL_PREC_DOUBLE);
+		const double E = gsl_sf_ellint_Ecomp(k, GSL_PREC_DOUBLE);
+		const double c = 2 * MU0_4_PI / std::sqrt(a2);
+		const double b_z = c * (K + (radius * radius - rho * rho - z * z) / b2 * E);
+		const double b_rho = rho == 0 ? 0 : c * z / rho * (-K + (radius * radius + rho * rho + z * z) / b2 * E);
+		return {{rho == 0 ? 0 : b_rho * x / rho, rho == 0 ? 0 : b_rho * y / rho, b_z}};
+	}
+
+	// off the axis of a circle, at distances from 0.05 R to 3 R from the wire
+	ReferenceCase circle_off_axis()
+	{
+		ReferenceCase c{"circle_loop", std::make_shared<Circle>(radius, 1, wire_radius), {}, {}, {{true, true, true}}};
+		for(int i = 0; i < 10; i++) {
+			for(int j = 0; j < 10; j++) {
+				const double distance = radius * 0.05 * std::pow(60.0, i / 9.0);
+				const double angle = 2 * M_PI * j / 10 + 0.1;
+				const double rho = radius + distance * std::cos(angle), z = distance * std::sin(angle);
+				if(rho <= 0) continue;
+				const double x = rho * std::cos(0.3), y = rho * std::sin(0.3);
+				c.points.push_back({{x, y, z}});
+				c.fields.push_back(loop_field(x, y, z));
+			}
+		}
+		return c;
+	}
+
+	// far from a circle, 3 to 30 radii from its centre
+	ReferenceCase circle_far()
+	{
+		ReferenceCase c{"circle_far", std::make_shared<Circle>(radius, 1, wire_radius), {}, {}, {{true, true, true}}};
+		for(int i = 0; i < 50; i++) {
+			const double r = radius * 3 * std::pow(10.0, i / 49.0);
+			const double theta = 0.2 + 2.7 * i / 49, phi = 0.7 * i;
+			const double x = r * std::sin(theta) * std::cos(phi), y = r * std::sin(theta) * std::sin(phi);
+			const double z = r * std::cos(theta);
+			c.points.push_back({{x, y, z}});
+			c.fields.push_back(loop_field(x, y, z));
+		}
+		return c;
+	}
+
+	// integrand<Index> counting its evaluations
+	struct CountedParams {
+		Params params;
+		std::size_t count;
+	};
+
+	template<int Index>
+	double counted_integrand(double t, void* p)
+	{
+		CountedParams* counted = static_cast<CountedParams*>(p);
+		counted->count++;
+		return integrand<Index>(t, &counted->params);
+	}
+
+	// One engine setting: computes B at a point, returns false where the
+	// engine does not apply. evaluations is increased by the integrand
+	// evaluations used (and left alone by engines that do not integrate).
+	using Engine = std::function<bool(const Curve&, const vector3D&, std::array<double, 3>&, std::size_t& evaluations)>;
+
+	struct Configuration {
+		std::string family;       // one line in the plots
+		double parameter;         // tolerance or order of the setting
+		std::function<Engine(const ReferenceCase&)> make;   // per case, e.g. to set up expansions
+		bool counts;              // evaluations are meaningful
+	};
+
+	std::vector<Configuration> configurations()
+	{
+		std::vector<Configuration> result;
+		const double tolerances[] = {1.E-2, 1.E-3, 1.E-4, 1.E-5, 1.E-6, 1.E-7, 1.E-8, 1.E-9, 1.E-10};
+		const int keys[] = {GSL_INTEG_GAUSS15, GSL_INTEG_GAUSS21, GSL_INTEG_GAUSS31,
+		                    GSL_INTEG_GAUSS41, GSL_INTEG_GAUSS51, GSL_INTEG_GAUSS61};
+
+		// The tolerances are relative ones; the absolute tolerance is the
+		// same fraction of the scale of the case (in units of the integrand),
+		// as FIELD_ABS_ERROR is for main().
+
+		// gsl_integration_qag with every rule
+		for(int key : keys) {
+			for(double tolerance : tolerances) {
+				result.push_back({"qag_gauss" + std::to_string(key == 1 ? 15 : key * 10 + 1), tolerance,
+					[key, tolerance](const ReferenceCase& c) -> Engine {
+						const double absolute = tolerance * c.scale() / MU0_4_PI;
+						std::shared_ptr<gsl_integration_workspace> workspace(gsl_integration_workspace_alloc(FIELD_LIMIT),
+						                                                     &gsl_integration_workspace_free);
+						return [key, tolerance, absolute, workspace](const Curve& curve, const vector3D& point,
+						                                   std::array<double, 3>& b, std::size_t& evaluations) {
+							CountedParams p{Params(&curve, &point), 0};
+							gsl_function fs[3] = {{&counted_integrand<0>, &p}, {&counted_integrand<1>, &p},
+							                      {&counted_integrand<2>, &p}};
+							for(unsigned i = 0; i < 3; i++) {
+								double error;
+								gsl_integration_qag(&fs[i], -curve.period/2, curve.period/2, absolute, tolerance, FIELD_LIMIT, key,
+								                    workspace.get(), &b[i], &error);
+								b[i] *= MU0_4_PI;
+							}
+							evaluations += p.count;
+							return true;
+						};
+					}, true});
+			}
+		}
+
+		// fixed order Gauss-Legendre over the whole curve
+		for(std::size_t n = 16; n <= 16384; n *= 2) {
+			result.push_back({"glfixed", static_cast<double>(n), [n](const ReferenceCase&) -> Engine {
+				std::shared_ptr<gsl_integration_glfixed_table> table(gsl_integration_glfixed_table_alloc(n),
+				                                                     &gsl_integration_glfixed_table_free);
+				return [table](const Curve& curve, const vector3D& point, std::array<double, 3>& b,
+				               std::size_t& evaluations) {
+					CountedParams p{Params(&curve, &point), 0};
+					gsl_function fs[3] = {{&counted_integrand<0>, &p}, {&counted_integrand<1>, &p},
+					                      {&counted_integrand<2>, &p}};
+					for(unsigned i = 0; i < 3; i++)
+						b[i] = MU0_4_PI * gsl_integration_glfixed(&fs[i], -curve.period/2, curve.period/2, table.get());
+					evaluations += p.count;
+					return true;
+				};
+			}, true});
+		}
+
+		// warm started adaptive quadrature along the points of the case
+		for(double tolerance : tolerances) {
+			result.push_back({"warm_start", tolerance, [tolerance](const ReferenceCase& c) -> Engine {
+				const double absolute = tolerance * c.scale() / MU0_4_PI;
+				std::shared_ptr<std::array<WarmStartIntegrator, 3>> warm(new std::array<WarmStartIntegrator, 3>{{
+					WarmStartIntegrator(FIELD_KEY), WarmStartIntegrator(FIELD_KEY), WarmStartIntegrator(FIELD_KEY)}});
+				return [tolerance, absolute, warm](const Curve& curve, const vector3D& point, std::array<double, 3>& b,
+				                         std::size_t& evaluations) {
+					CountedParams p{Params(&curve, &point), 0};
+					const gsl_function fs[3] = {{&counted_integrand<0>, &p}, {&counted_integrand<1>, &p},
+					                            {&counted_integrand<2>, &p}};
+					for(unsigned i = 0; i < 3; i++) {
+						double error;
+						b[i] = MU0_4_PI * (*warm)[i].integrate(&fs[i], -curve.period/2, curve.period/2, absolute, tolerance,
+						                                       FIELD_LIMIT, error);
+					}
+					evaluations += p.count;
+					return true;
+				};
+			}, true});
+		}
+
+		// far field expansion, where it covers the point
+		for(double tolerance : tolerances) {
+			result.push_back({"multipole", tolerance, [tolerance](const ReferenceCase& c) -> Engine {
+				std::shared_ptr<const MultipoleExpansion> multipole(
+					new MultipoleExpansion(*c.curve, tolerance, tolerance * c.scale() / MU0_4_PI, FIELD_MULTIPOLE_DISTANCE, 40));
+				return [multipole](const Curve&, const vector3D& point, std::array<double, 3>& b, std::size_t&) {
+					std::tuple<vector3D, vector3D> field;
+					if(!multipole->covers(point) || !multipole->evaluate(point, field)) return false;
+					const vector3D& B = std::get<0>(field);
+					b = {{MU0_4_PI * get<0>(B), MU0_4_PI * get<1>(B), MU0_4_PI * get<2>(B)}};
+					return true;
+				};
+			}, false});
+		}
+
+		// biot_savart as main() runs it, with the settings of field_configure.h
+		result.push_back({"biot_savart", FIELD_REL_ERROR, [](const ReferenceCase& c) -> Engine {
+			// a placed copy, so the expansions set up here stay with this engine
+			Scene curve;
+			curve.curves.push_back(c.curve);
+			std::shared_ptr<Scene> scene(new Scene(curve.unit(0)));
+			std::ostringstream report;
+			prepare(*scene, report);
+			std::shared_ptr<FieldWorkspace> workspace(new FieldWorkspace);
+			return [scene, workspace](const Curve&, const vector3D& point, std::array<double, 3>& b, std::size_t&) {
+				const vector3D B = std::get<0>(biot_savart(scene->curves[0].get(), point, workspace->get(), 
+				                                           {{true, true, true}}, nullptr, scene->quadrature));
+				b = {{get<0>(B), get<1>(B), get<2>(B)}};
+				return true;
+			};
+		}, false});
+		return result;
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values.empty() ? 0 : values[values.size() / 2];
+	}
+
+}
+
+
+int main()
+{
+	const std::vector<ReferenceCase> cases{circle_on_axis(), coil_on_axis(), circle_off_axis(), circle_far()};
+	const std::vector<Configuration> settings = configurations();
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	// tight tolerances are expected to fail now and then; the error
+	// against the reference tells how badly
+	gsl_set_error_handler_off();
+
+	// one block per case and engine family, in the order of settings
+	struct Block {
+		std::size_t case_index;
+		std::string family;
+		std::ostringstream lines;
+	};
+	std::vector<std::unique_ptr<Block>> blocks;
+	for(std::size_t n = 0; n < cases.size(); n++) {
+		const ReferenceCase& c = cases[n];
+		const double scale = c.scale();
+		for(const Configuration& setting : settings) {
+			const Engine engine = setting.make(c);
+			std::vector<double> errors;
+			std::size_t evaluations = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for(std::size_t p = 0; p < c.points.size(); p++) {
+				const vector3D point{c.points[p][0], c.points[p][1], c.points[p][2]};
+				std::array<double, 3> b;
+				if(!engine(*c.curve, point, b, evaluations)) continue;
+				double error = 0;
+				for(unsigned i = 0; i < 3; i++) {
+					if(c.compare[i]) error = std::max(error, std::abs(b[i] - c.fields[p][i]));
+				}
+				errors.push_back(error / scale);
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if(errors.empty()) continue;
+
+			if(blocks.empty() || blocks.back()->case_index != n || blocks.back()->family != setting.family)
+				blocks.emplace_back(new Block{n, setting.family, std::ostringstream()});
+			blocks.back()->lines << c.name << '\t' << setting.family << '\t' << setting.parameter << '\t'
+				<< median(errors) << '\t' << *std::max_element(errors.begin(), errors.end()) << '\t'
+				<< (setting.counts ? evaluations / static_cast<double>(errors.size()) : nan) << '\t'
+				<< 1.E6 * seconds / errors.size() << '\t' << errors.size() << '\n';
+		}
+		std::cout << "Done with " << c.name << ".\n";
+	}
+
+	std::ofstream outfile;
+	outfile.open(ACCURACY_DAT);
+	outfile << "#case\tengine\tparameter\tmedian_error\tmax_error\tevaluations\tmicroseconds\tnr_points\n";
+	for(std::size_t i = 0; i < blocks.size(); i++) {
+		if(i > 0) outfile << "\n\n";
+		outfile << blocks[i]->lines.str();
+	}
+	outfile.close();
+	std::cout << "Saved the results to " << ACCURACY_DAT << ".\n";
+
+	// one panel per case, one line per engine family
+	auto plot = [&](const char* png, int column, const char* label) {
+		Gnuplot gp;
+		gp << "set terminal pngcairo size 1600,1200\n"
+		   << "set output '" << png << "'\n"
+		   << "set logscale xy\n"
+		   << "set format y '%.0e'\n"
+		   << "set key bottom left font ',8'\n"
+		   << "set multiplot layout 2,2\n";
+		for(std::size_t n = 0; n < cases.size(); n++) {
+			gp << "set title '" << cases[n].name << "'\n"
+			   << "set xlabel '" << label << "'\n"
+			   << "set ylabel 'max error / max |B|'\n"
+			   << "plot ";
+			bool first = true;
+			for(std::size_t i = 0; i < blocks.size(); i++) {
+				if(blocks[i]->case_index != n) continue;
+				gp << (first ? "" : ", ") << "'" << ACCURACY_DAT << "' index " << i << " using " << column
+				   << ":5 with linespoints title '" << blocks[i]->family << "'";
+				first = false;
+			}
+			gp << "\n";
+		}
+		gp << "unset multiplot\n";
+	};
+	plot(ACCURACY_EVALUATIONS_PNG, 6, "integrand evaluations per point");
+	plot(ACCURACY_TIME_PNG, 7, "wall time per point [us]");
+	std::cout << "Plotted them to " << ACCURACY_EVALUATIONS_PNG << " and " << ACCURACY_TIME_PNG << ".\n";
+	return 0;
+}
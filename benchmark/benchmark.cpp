@@ -0,0 +1,142 @@
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../field.h"
+
+
+// Micro benchmarks of the hot paths of the solver and a full run on a small
+// grid. Run with --benchmark_out=<file> --benchmark_out_format=json to keep
+// results for comparing commits.
+
+namespace {
+
+	std::shared_ptr<Curve> make_curve(int shape)
+	{
+		if(shape == 0) return std::make_shared<Circle>(0.01, 1, 1.E-4);
+		return std::make_shared<Coil>(0.01, 1, 10, 0.05, 1.E-4);
+	}
+
+	// point of the given kind relative to the curves of make_curve()
+	vector3D make_point(int kind)
+	{
+		switch(kind) {
+			case 0: return vector3D{0.012, 0, 0.001};        // near the wire
+			case 1: return vector3D{0.2, 0.1, 0.3};          // far away
+			default: return vector3D{0.01, 0, 5.E-5};        // inside the wire
+		}
+	}
+
+	const char* shape_name(int shape) { return shape == 0 ? "circle" : "coil"; }
+	const char* point_name(int kind) { return kind == 0 ? "near" : kind == 1 ? "far" : "in_wire"; }
+
+}
+
+
+static void BM_Vector3D(benchmark::State& state)
+{
+	const vector3D v{0.1, 0.2, 0.3}, w{-0.3, 0.5, 0.7};
+	for(auto _ : state) {
+		const vector3D r = v - w;
+		const vector3D s = 0.5 * (r + v);
+		double c = cross_product<0>(s, w) + cross_product<1>(s, w) + cross_product<2>(s, w);
+		benchmark::DoNotOptimize(c += s * r + r.length());
+	}
+}
+BENCHMARK(BM_Vector3D);
+
+template<int Index>
+static void BM_Integrand(benchmark::State& state)
+{
+	const std::shared_ptr<Curve> curve = make_curve(state.range(0));
+	const vector3D point = make_point(0);
+	Params params(curve.get(), &point);
+	double t = -curve->period / 2;
+	const double dt = curve->period / 1000;
+	for(auto _ : state) {
+		benchmark::DoNotOptimize(integrand<Index>(t, &params));
+		t = t + dt > curve->period / 2 ? -curve->period / 2 : t + dt;
+	}
+	state.SetLabel(shape_name(state.range(0)));
+}
+BENCHMARK_TEMPLATE(BM_Integrand, 0)->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_Integrand, 1)->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_Integrand, 2)->Arg(0)->Arg(1);
+
+// biot_savart by quadrature alone; arguments: shape, kind of point
+static void BM_BiotSavart(benchmark::State& state)
+{
+	const std::shared_ptr<Curve> curve = make_curve(state.range(0));
+	const vector3D point = make_point(state.range(1));
+	const FieldWorkspace workspace;
+	for(auto _ : state) {
+		benchmark::DoNotOptimize(biot_savart(curve.get(), point, workspace.get()));
+	}
+	state.SetLabel(std::string(shape_name(state.range(0))) + "/" + point_name(state.range(1)));
+}
+BENCHMARK(BM_BiotSavart)->ArgsProduct({{0, 1}, {0, 1, 2}});
+
+// the same with the curve prepared as by main(), i.e. multipole expansion
+// (and tree code where it applies) in place
+static void BM_BiotSavartPrepared(benchmark::State& state)
+{
+	Scene scene;
+	scene.curves.push_back(make_curve(state.range(0)));
+	std::ostringstream report;
+	prepare(scene, report);
+	const vector3D point = make_point(state.range(1));
+	const FieldWorkspace workspace;
+	for(auto _ : state) {
+		benchmark::DoNotOptimize(biot_savart(scene.curves[0].get(), point, workspace.get()));
+	}
+	state.SetLabel(std::string(shape_name(state.range(0))) + "/" + point_name(state.range(1)));
+}
+BENCHMARK(BM_BiotSavartPrepared)->ArgsProduct({{0, 1}, {0, 1, 2}});
+
+static Range make_range(double min, double max, std::size_t nr_steps)
+{
+	Range range;
+	range.min = nr_steps == 1 ? (min + max) / 2 : min;
+	range.max = max;
+	range.nr_steps = nr_steps;
+	range.step = nr_steps == 1 ? 0 : (max - min) / (nr_steps - 1);
+	return range;
+}
+
+// the field.dat writer on an n x 1 x n grid
+static void BM_WriteGrid(benchmark::State& state)
+{
+	const std::size_t n = state.range(0);
+	const Range x_range = make_range(-0.05, 0.05, n), y_range = make_range(0, 0, 1), z_range = x_range;
+	std::vector<std::tuple<vector3D, vector3D>> fields;
+	for(std::size_t i = 0; i < n * n; i++) 
+		fields.emplace_back(vector3D{1.E-6 * i, 2.E-6, -3.E-6 * i}, vector3D{1.E-9, 2.E-9, 3.E-9});
+	for(auto _ : state) {
+		std::ostringstream out;
+		benchmark::DoNotOptimize(write_grid(x_range, y_range, z_range, fields, out));
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+BENCHMARK(BM_WriteGrid)->Arg(100);
+
+// prepare() and evaluate_grid() of a coil on an n x 1 x n grid, as main()
+// runs them without the basis cache
+static void BM_SmallGrid(benchmark::State& state)
+{
+	const std::size_t n = state.range(0);
+	const Range x_range = make_range(-0.05, 0.05, n), y_range = make_range(0, 0, 1), z_range = x_range;
+	for(auto _ : state) {
+		Scene scene;
+		scene.curves.push_back(make_curve(1));
+		std::ostringstream report;
+		prepare(scene, report);
+		benchmark::DoNotOptimize(evaluate_grid(scene, x_range, y_range, z_range, report));
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+	state.SetLabel("coil");
+}
+BENCHMARK(BM_SmallGrid)->Arg(20)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
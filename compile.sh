@@ -29,5 +29,11 @@ else
 	GSL_LIBS="-lgsl -lgslcblas"
 fi
 
-echo "main: main.cpp configure.h vector3D.h
-	g++ -std=c++11 -o main main.cpp -lm $BOOST_LIBS $GSL_LIBS $BOOST_INCLUDE $GSL_INCLUDE" >> Makefile
+echo "main: main.cpp configure.h field_configure.h vector3D.h field.h autotune.h adaptive_mesh.h multipole.h straight_segments.h barnes_hut.h field_basis.h thread_pool.h interpolator.h warm_start.h field_lines.h field_server.h space_filling.h statistics.h trace.h perf_counters.h progress.h quadrature.h
+	g++ -std=c++11 -O3 -pthread -o main main.cpp -lm $BOOST_LIBS $GSL_LIBS $BOOST_INCLUDE $GSL_INCLUDE
+
+bench: benchmark/benchmark.cpp field_configure.h vector3D.h field.h multipole.h straight_segments.h barnes_hut.h warm_start.h space_filling.h statistics.h trace.h perf_counters.h progress.h quadrature.h
+	g++ -std=c++11 -O3 -pthread -o bench benchmark/benchmark.cpp -lbenchmark -lm $GSL_LIBS $GSL_INCLUDE
+
+accuracy: benchmark/accuracy.cpp field_configure.h vector3D.h field.h multipole.h straight_segments.h barnes_hut.h warm_start.h space_filling.h statistics.h trace.h perf_counters.h progress.h quadrature.h
+	g++ -std=c++11 -O3 -pthread -o accuracy benchmark/accuracy.cpp -lm $BOOST_LIBS $GSL_LIBS $BOOST_INCLUDE $GSL_INCLUDE" >> Makefile
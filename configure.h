@@ -1,11 +1,46 @@
 #ifndef CONFIGURE_H
 #define CONFIGURE_H
 
-#define REL_ERROR 1.E-2
-#define ABS_ERROR 1.E-5
-#define KEY GSL_INTEG_GAUSS41
+#include "field_configure.h"
+
+#define AUTOTUNE false
+#define AUTOTUNE_CLASSES 4
+#define AUTOTUNE_SAMPLES 8
+#define AUTOTUNE_REPEATS 3
+#define BASIS_CACHE false
+#define INTERPOLATOR false
+#define INTERPOLATION_CHECKS 64
+#define FIELD_LINES_INTERPOLATED true
+#define FIELD_LINES_TOLERANCE 1.E-5
+#define FIELD_LINES_MAX_LENGTH 10
+#define FIELD_LINES_MAX_POINTS 10000
+#define ADAPTIVE_MESH false
+#define ADAPTIVE_BASE_STEPS 8
+#define ADAPTIVE_MAX_DEPTH 5
+#define ADAPTIVE_MAX_POINTS 20000
+#define ADAPTIVE_TOLERANCE 1.E-2
+#define COST_MAP false
+#define NR_THREADS 0
+#define BATCH_TILES 16
+#define SERVER_CHUNK_SIZE 64
+#define SERVER_MAX_POINTS (SERVER_CHUNK_SIZE * 16384)
+#define POINTS_CHUNK_SIZE 256
 #define CONFIG "config.txt"
 #define CURVE_DAT "curve.dat"
 #define FIELD_DAT "field.dat"
+#define COST_DAT "cost.dat"
+#define MESH_DAT "mesh.dat"
+#define BASIS_DAT "basis.dat"
+#define CURRENTS_DAT "currents.dat"
+#define INTERPOLATOR_DAT "interpolator.dat"
+#define SEEDS_DAT "seeds.dat"
+#define FIELD_LINES_DAT "field_lines.dat"
+#define SERVER_SOCKET "/tmp/biot_savart.sock"
+#define SWEEP_CONFIG "sweep.txt"
+#define SWEEP_DAT "sweep.dat"
+#define QUADRATURE_CONFIG "quadrature.txt"
+#define AUTOTUNE_DAT "autotune.dat"
+#define STATISTICS_JSON "statistics.json"
+#define TRACE_JSON "trace.json"
 
 #endif // CONFIGURE_H
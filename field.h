@@ -0,0 +1,1228 @@
+#ifndef FIELD_H
+#define FIELD_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+extern "C" {
+	#include <gsl/gsl_errno.h>
+	#include <gsl/gsl_integration.h>
+	#include <gsl/gsl_math.h>
+}
+
+#include "vector3D.h"
+#include "multipole.h"
+#include "straight_segments.h"
+#include "barnes_hut.h"
+#include "warm_start.h"
+#include "space_filling.h"
+#include "statistics.h"
+#include "trace.h"
+#include "progress.h"
+#include "quadrature.h"
+#include "field_configure.h"
+
+
+// Field of the curves: the curve classes, biot_savart, scenes of several
+// conductors and the grid driver, usable without main.cpp. FieldEvaluator at
+// the end is the batch interface for code embedding the solver.
+//
+// An integral that reaches its interval limit is not an error here: it is
+// counted (see count_integration()) and its estimate is used. prepare(), and
+// so FieldEvaluator, therefore turn the GSL error handler off, which would
+// otherwise abort the program on GSL_EMAXITER.
+
+#define MU0_4_PI 1.E-7
+
+
+inline std::ostream& operator <<(std::ostream& out, const std::tuple<vector3D, vector3D>& field) 
+{
+	out << get<0>(std::get<0>(field)) << '\t' << get<0>(std::get<1>(field))
+	    << '\t' << get<1>(std::get<0>(field)) << '\t' << get<1>(std::get<1>(field))
+	    << '\t' << get<2>(std::get<0>(field)) << '\t' << get<2>(std::get<1>(field));
+	return out;
+}
+
+// Default report of the functions below: discards everything, so the solver
+// only writes where it is told to. It has no buffer, so any number of threads
+// may share it, and callers use it wherever a report is not wanted.
+inline std::ostream& silent()
+{
+	static std::ostream stream(nullptr);
+	return stream;
+}
+
+
+// Reflection or rotation by 180 degrees about a coordinate axis which maps 
+// the curve onto itself. Points transform as x -> Sx with S = diag(sx, sy, sz)
+// and the field as B(Sx) = sign * S B(x). sign accounts both for B being a
+// pseudovector and for the direction of the current along the image curve.
+struct Symmetry {
+	int sx, sy, sz;
+	int sign;
+
+	Symmetry operator*(const Symmetry& other) const noexcept
+	{
+		return Symmetry{sx * other.sx, sy * other.sy, sz * other.sz, sign * other.sign};
+	}
+
+	bool operator==(const Symmetry& other) const noexcept
+	{
+		return sx == other.sx && sy == other.sy && sz == other.sz && sign == other.sign;
+	}
+
+	// field at Sx given the field at x
+	std::tuple<vector3D, vector3D> apply(const std::tuple<vector3D, vector3D>& field) const
+	{
+		const vector3D& b = std::get<0>(field);
+		const vector3D& err = std::get<1>(field);
+		return std::tuple<vector3D, vector3D>(
+			vector3D{sign * sx * get<0>(b), sign * sy * get<1>(b), sign * sz * get<2>(b)},
+			vector3D{get<0>(err), get<1>(err), get<2>(err)});
+	}
+
+	// true if component Index vanishes at the points left invariant by S
+	template<unsigned int Index>
+	bool kills() const noexcept
+	{
+		static_assert(Index < 3, "Symmetry acts on 3 dimensional vectors");
+		return sign * (Index == 0 ? sx : Index == 1 ? sy : sz) == -1;
+	}
+};
+
+// closure of the generators under composition, identity excluded
+inline std::vector<Symmetry> symmetry_group(const std::vector<Symmetry>& generators)
+{
+	const Symmetry identity{1, 1, 1, 1};
+	std::vector<Symmetry> group{identity};
+	for(std::size_t i = 0; i < group.size(); i++) {
+		for(const Symmetry& g : generators) {
+			Symmetry s = group[i] * g;
+			if(std::find(group.begin(), group.end(), s) == group.end())
+				group.push_back(s);
+		}
+	}
+	group.erase(group.begin());
+	return group;
+}
+
+
+// The curve at nr_samples points of equal parameter spacing, for cheap
+// estimates of the distance of a point to the wire and of the magnitude of
+// the integrand there.
+class CurveSamples {
+private:
+	std::vector<vector3D> points;
+	std::vector<double> weights;   // |dl/dt| dt
+	double wire_radius;
+	double length;
+
+public:
+	template<class CurveType>
+	explicit CurveSamples(const CurveType& curve, std::size_t nr_samples = 256) 
+		: wire_radius{curve.wireR}, length{0}
+	{
+		const double dt = curve.period / nr_samples;
+		for(std::size_t i = 0; i < nr_samples; i++) {
+			const double t = - curve.period/2 + (i + 0.5) * dt;
+			points.push_back(curve.parametrize(t));
+			weights.push_back(curve.diff_el(t).length() * dt);
+			length += weights.back();
+		}
+	}
+
+	double get_length() const noexcept { return length; }
+
+	// distance to the nearest sample (at most half a sample spacing more
+	// than the distance to the curve) and the sum of |dl| / r^2 over the
+	// samples, r being at least the wire radius: the integral of |dB| for
+	// unit current, up to MU0_4_PI
+	void estimate(const vector3D& point, double& distance, double& magnitude) const noexcept
+	{
+		distance = length;
+		magnitude = 0;
+		for(std::size_t i = 0; i < points.size(); i++) {
+			const double r = (point - points[i]).length();
+			distance = std::min(distance, r);
+			const double r_wire = std::max(r, wire_radius);
+			magnitude += weights[i] / (r_wire * r_wire);
+		}
+	}
+};
+
+
+class Curve {
+public:
+	const double current; // current through the curve
+	const double period;
+	const double wireR; 
+
+	// far field expansion used by biot_savart outside its bounding sphere,
+	// set up by prepare() once the curve is constructed
+	std::unique_ptr<const MultipoleExpansion> multipole;
+
+	// tree code over the straight pieces of the curve, set up by prepare() for
+	// curves with many of them
+	std::unique_ptr<const BarnesHutTree> tree;
+
+	// samples for settings of the quadrature that depend on the point, set
+	// up by prepare() if the quadrature of the scene has such settings
+	std::unique_ptr<const CurveSamples> samples;
+
+	Curve(double period_, double current_, double wireR_) : period{period_}, current{current_}, wireR{wireR_} {}
+
+	virtual vector3D diff_el(double t) const noexcept =0;
+	virtual vector3D parametrize(double t) const noexcept =0;
+
+	// true if the field only depends on (rho, z), i.e. the curve is
+	// invariant under rotations around the z axis
+	virtual bool axisymmetric() const noexcept { return false; }
+
+	// generators of the symmetry group of the curve
+	virtual std::vector<Symmetry> symmetries() const { return {}; }
+
+	// parameter values at which the curve has kinks, including both ends; 
+	// empty if the curve is smooth on [-period/2, period/2]
+	virtual std::vector<double> breakpoints() const { return {}; }
+
+	// Curves for which the Biot-Savart integral is known in closed form
+	// override this to set the field (and its error) at the point for unit
+	// current (in the units of the integrand) and return true.
+	virtual bool closed_form(const vector3D&, std::tuple<vector3D, vector3D>&) const
+	{
+		return false; 
+	}
+	virtual ~Curve() noexcept =default;
+};
+
+
+class Circle : public Curve {
+private:
+	const double R;
+public:
+	Circle(double R_, double current_, double wireR_) : Curve{2*M_PI, current_, wireR_}, R{R_} {}
+
+	virtual vector3D parametrize(double t) const noexcept override
+	{
+		return vector3D(R * cos(t), R * sin(t), 0);
+	}
+
+	virtual vector3D diff_el(double t) const noexcept override
+	{
+		return vector3D(-R * sin(t), R * cos(t), 0);
+	}
+
+	virtual bool axisymmetric() const noexcept override { return true; }
+
+	// mirroring x or y reverses the current, mirroring z does not
+	virtual std::vector<Symmetry> symmetries() const override
+	{
+		return { {-1, 1, 1, 1}, {1, -1, 1, 1}, {1, 1, -1, -1} };
+	}
+
+	virtual ~Circle() noexcept =default;
+
+};
+
+
+class Coil : public Curve {
+private:
+	const double R;
+	const double length;
+public:
+	Coil(double R_, double current_, std::size_t n, double length_, double wireR_) 
+		: Curve{n*2*M_PI, current_, wireR_}, R{R_}, length{length_}
+	{}
+
+	virtual vector3D parametrize(double t) const noexcept override
+	{
+		return vector3D(R * cos(t), R * sin(t), length * t / period);
+	}
+
+	virtual vector3D diff_el(double t) const noexcept override
+	{
+		return vector3D(-R * sin(t), R * cos(t), length / period);
+	}
+
+	// rotation by 180 degrees around the x axis maps t -> -t, i.e. reverses
+	// the current
+	virtual std::vector<Symmetry> symmetries() const override
+	{
+		return { {1, -1, -1, -1} };
+	}
+
+	virtual ~Coil() noexcept =default;
+
+};
+
+
+// Piecewise straight conductor through a list of vertices. Segment i is
+// parametrized by t in [i - n/2, i + 1 - n/2], n being the number of
+// segments. The field is the sum of the closed form fields of the segments.
+class Polyline : public Curve {
+private:
+	const std::vector<double> x, y, z;
+
+	std::size_t segment(double t) const noexcept
+	{
+		const double s = std::floor(t + period/2);
+		return s <= 0 ? 0 : std::min(static_cast<std::size_t>(s), x.size() - 2);
+	}
+
+public:
+	Polyline(std::vector<double> x_, std::vector<double> y_, std::vector<double> z_, 
+	         double current_, double wireR_)
+		: Curve{static_cast<double>(x_.size() - 1), current_, wireR_}, 
+		  x(std::move(x_)), y(std::move(y_)), z(std::move(z_))
+	{}
+
+	virtual vector3D parametrize(double t) const noexcept override
+	{
+		const std::size_t i = segment(t);
+		const double f = t + period/2 - i;
+		return vector3D(x[i] + f * (x[i+1] - x[i]), y[i] + f * (y[i+1] - y[i]), z[i] + f * (z[i+1] - z[i]));
+	}
+
+	virtual vector3D diff_el(double t) const noexcept override
+	{
+		const std::size_t i = segment(t);
+		return vector3D(x[i+1] - x[i], y[i+1] - y[i], z[i+1] - z[i]);
+	}
+
+	virtual std::vector<double> breakpoints() const override
+	{
+		std::vector<double> result(x.size());
+		for(std::size_t i = 0; i < x.size(); i++) 
+			result[i] = i - period/2;
+		return result;
+	}
+
+	// see straight_segments_field(); segment i runs from vertex i to i + 1
+	virtual bool closed_form(const vector3D& point, std::tuple<vector3D, vector3D>& field) const override
+	{
+		const double p[3] = {get<0>(point), get<1>(point), get<2>(point)};
+		double b[3], err[3];
+		straight_segments_field(x.data(), y.data(), z.data(), x.data() + 1, y.data() + 1, z.data() + 1,
+		                        x.size() - 1, p, wireR, b, err);
+		field = std::tuple<vector3D, vector3D>(vector3D{b[0], b[1], b[2]}, vector3D{err[0], err[1], err[2]});
+		return true;
+	}
+
+	virtual ~Polyline() noexcept =default;
+
+};
+
+
+// Curve moved to another position and orientation: the local z axis of the
+// underlying shape is turned into axis and its origin moved to position.
+// The current of the placed curve replaces the one of the shape, which may
+// be shared by several placements.
+// The rotation is the one about axis x e_z, so that shapes placed along
+// +-z keep their coordinate axes.
+class PlacedCurve : public Curve {
+private:
+	const std::shared_ptr<const Curve> shape;
+	std::array<double, 9> rotation;   // row major, local -> global
+	std::array<double, 3> position;
+
+	vector3D to_global(const vector3D& v) const noexcept
+	{
+		const double x = get<0>(v), y = get<1>(v), z = get<2>(v);
+		return vector3D(rotation[0]*x + rotation[1]*y + rotation[2]*z,
+		                rotation[3]*x + rotation[4]*y + rotation[5]*z,
+		                rotation[6]*x + rotation[7]*y + rotation[8]*z);
+	}
+
+	vector3D to_local(const vector3D& point) const noexcept
+	{
+		const double x = get<0>(point) - position[0];
+		const double y = get<1>(point) - position[1];
+		const double z = get<2>(point) - position[2];
+		return vector3D(rotation[0]*x + rotation[3]*y + rotation[6]*z,
+		                rotation[1]*x + rotation[4]*y + rotation[7]*z,
+		                rotation[2]*x + rotation[5]*y + rotation[8]*z);
+	}
+
+	// true if the rotation only flips signs of the coordinate axes
+	bool diagonal() const noexcept
+	{
+		return rotation[1] == 0 && rotation[2] == 0 && rotation[3] == 0
+		    && rotation[5] == 0 && rotation[6] == 0 && rotation[7] == 0;
+	}
+
+public:
+	PlacedCurve(std::shared_ptr<const Curve> shape_, const std::array<double, 3>& position_, 
+	            const std::array<double, 3>& axis, double current_)
+		: Curve{shape_->period, current_, shape_->wireR}, shape{std::move(shape_)}, position(position_)
+	{
+		const double norm = std::sqrt(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+		const double a[3] = {axis[0] / norm, axis[1] / norm, axis[2] / norm};
+		if(a[2] < -1 + 1.E-12) {
+			rotation = {{1, 0, 0, 0, -1, 0, 0, 0, -1}};
+		} else {
+			// Rodrigues: R = 1 + [v]x + [v]x^2 / (1 + c) with v = e_z x a, c = e_z.a
+			const double vx = -a[1], vy = a[0], c = a[2];
+			const double k = 1 / (1 + c);
+			rotation = {{1 - k*vy*vy, k*vx*vy,     vy,
+			             k*vx*vy,     1 - k*vx*vx, -vx,
+			             -vy,         vx,          1 - k*(vx*vx + vy*vy)}};
+		}
+	}
+
+	virtual vector3D parametrize(double t) const noexcept override
+	{
+		const vector3D x = to_global(shape->parametrize(t));
+		return vector3D(get<0>(x) + position[0], get<1>(x) + position[1], get<2>(x) + position[2]);
+	}
+
+	virtual vector3D diff_el(double t) const noexcept override
+	{
+		return to_global(shape->diff_el(t));
+	}
+
+	virtual bool axisymmetric() const noexcept override
+	{
+		return shape->axisymmetric() && rotation[8] == 1 && position[0] == 0 && position[1] == 0;
+	}
+
+	// S commutes with a diagonal rotation, so the symmetries of the shape
+	// survive if they also leave the position invariant
+	virtual std::vector<Symmetry> symmetries() const override
+	{
+		std::vector<Symmetry> result;
+		if(!diagonal()) return result;
+		for(const Symmetry& s : symmetry_group(shape->symmetries())) {
+			if((s.sx == 1 || position[0] == 0) && (s.sy == 1 || position[1] == 0) 
+			   && (s.sz == 1 || position[2] == 0))
+				result.push_back(s);
+		}
+		return result;
+	}
+
+	virtual std::vector<double> breakpoints() const override { return shape->breakpoints(); }
+
+	virtual bool closed_form(const vector3D& point, std::tuple<vector3D, vector3D>& field) const override
+	{
+		std::tuple<vector3D, vector3D> local;
+		if(!shape->closed_form(to_local(point), local)) return false;
+		const vector3D& err = std::get<1>(local);
+		const double e[3] = {get<0>(err), get<1>(err), get<2>(err)};
+		field = std::tuple<vector3D, vector3D>(to_global(std::get<0>(local)), 
+			vector3D{std::abs(rotation[0])*e[0] + std::abs(rotation[1])*e[1] + std::abs(rotation[2])*e[2],
+			         std::abs(rotation[3])*e[0] + std::abs(rotation[4])*e[1] + std::abs(rotation[5])*e[2],
+			         std::abs(rotation[6])*e[0] + std::abs(rotation[7])*e[1] + std::abs(rotation[8])*e[2]});
+		return true;
+	}
+
+	virtual ~PlacedCurve() noexcept =default;
+
+};
+
+
+struct Params {
+	const Curve* curve;
+	const vector3D* point;
+	std::size_t nr_calls;   // of the integrand, for the statistics
+
+	Params(const Curve* curve_, const vector3D* point_) : curve{curve_}, point{point_}, nr_calls{0} {}
+};
+
+template<int Index>
+double integrand(double t, void* params) 
+{
+	Params* p = static_cast<Params*>(params);
+	p->nr_calls++;
+	vector3D r = *(p->point) - p->curve->parametrize(t);
+	if(r.length()==0) 
+		return 0;
+	
+	vector3D dl = p->curve->diff_el(t);
+	double cos_theta = 1.0 / (r.length() * dl.length()) * (r * dl);
+	double d_to_center = sqrt(1 - pow(cos_theta, 2)) * r.length();
+	
+	if(d_to_center < p->curve->wireR) {
+		return p->curve->current * pow(d_to_center, 2)/pow(p->curve->wireR, 2) 
+			* cross_product<Index>(dl, r) / pow(r.length(), 3.);
+	}
+	return p->curve->current 
+		* cross_product<Index>(dl, r) / pow(r.length(), 3.);
+}
+
+
+// Work done for one point, for the cost map (see evaluate_grid()).
+struct PointCost {
+	std::size_t integrand_calls;
+	std::size_t subintervals;
+	double microseconds;
+	int status;                  // GSL status of the first integral that failed
+};
+
+// cost of the point the calling thread is evaluating
+inline PointCost& current_cost()
+{
+	static thread_local PointCost cost{0, 0, 0, GSL_SUCCESS};
+	return cost;
+}
+
+// adds an adaptive integration with nr_subintervals intervals, which ended
+// with the GSL status, to the statistics and the cost of the point
+inline void count_integration(std::size_t nr_subintervals, int status)
+{
+	PointCost& cost = current_cost();
+	cost.subintervals += nr_subintervals;
+	if(cost.status == GSL_SUCCESS) cost.status = status;
+	if(!FIELD_STATISTICS) return;
+	statistics::Counters& counters = statistics::counters();
+	statistics::add(counters.subintervals, nr_subintervals);
+	if(status == GSL_EMAXITER) statistics::add(counters.limit_hits);
+}
+
+inline void count_integrand_calls(std::size_t nr_calls)
+{
+	current_cost().integrand_calls += nr_calls;
+	if(FIELD_STATISTICS) statistics::add(statistics::counters().integrand_calls, nr_calls);
+}
+
+// the settings of field_configure.h
+inline const Quadrature& default_quadrature()
+{
+	static const Quadrature quadrature;
+	return quadrature;
+}
+
+// settings of quadrature for the integral of curve at point; the settings
+// that depend on the point need the samples of the curve and are left out
+// without them
+inline QuadratureSettings quadrature_at(const Quadrature& quadrature, const Curve& curve, const vector3D& point)
+{
+	if(!quadrature.local() || !curve.samples) return quadrature.defaults;
+	double distance, magnitude;
+	curve.samples->estimate(point, distance, magnitude);
+	QuadratureSettings settings = quadrature.at(distance);
+	if(quadrature.scaled_abs_error) settings.abs_error *= std::abs(curve.current) * magnitude;
+	return settings;
+}
+
+// Integral of f over [a, b] with the rule of settings, counted in the
+// statistics; returns the GSL status. cquad brings its own workspace (one per
+// thread), qag and qags use workspace.
+inline int integrate_rule(const gsl_function* f, double a, double b, const QuadratureSettings& settings,
+                          gsl_integration_workspace* workspace, double& result, double& error)
+{
+	if(settings.key == QUADRATURE_CQUAD) {
+		// GSL suggests 100 to 200 intervals for cquad
+		static thread_local std::unique_ptr<gsl_integration_cquad_workspace, void (*)(gsl_integration_cquad_workspace*)>
+			cquad_workspace(gsl_integration_cquad_workspace_alloc(200), &gsl_integration_cquad_workspace_free);
+		const int status = gsl_integration_cquad(f, a, b, settings.abs_error, settings.rel_error, 
+		                                         cquad_workspace.get(), &result, &error, nullptr);
+		count_integration(0, status);
+		return status;
+	}
+	const int status = settings.key == QUADRATURE_QAGS
+		? gsl_integration_qags(f, a, b, settings.abs_error, settings.rel_error, settings.limit, 
+		                       workspace, &result, &error)
+		: gsl_integration_qag(f, a, b, settings.abs_error, settings.rel_error, settings.limit, settings.key, 
+		                      workspace, &result, &error);
+	count_integration(workspace->size, status);
+	return status;
+}
+
+// With warm given, the integrals of the three components start from the
+// partitions of the previous call with the same warm (see WarmStartIntegrator)
+// instead of using workspace; only the Gauss-Kronrod rules start warm. The
+// tolerances, rule and interval limit are those of quadrature at the point,
+// the limit capped by the size of workspace.
+inline std::tuple<vector3D, vector3D> biot_savart(Curve* curve, const vector3D &point, gsl_integration_workspace* workspace,
+                                           const std::array<bool, 3>& components = {{true, true, true}},
+                                           std::array<WarmStartIntegrator, 3>* warm = nullptr,
+                                           const Quadrature& quadrature = default_quadrature()) 
+{
+	
+	if(curve->multipole && curve->multipole->covers(point)) {
+		std::tuple<vector3D, vector3D> field;
+		if(curve->multipole->evaluate(point, field)) {
+			return std::tuple<vector3D, vector3D>(MU0_4_PI * std::get<0>(field), 
+			                                      MU0_4_PI * std::get<1>(field));
+		}
+	}
+
+	if(curve->tree) {
+		std::tuple<vector3D, vector3D> field;
+		if(curve->tree->evaluate(point, field)) {
+			return std::tuple<vector3D, vector3D>(MU0_4_PI * std::get<0>(field), 
+			                                      MU0_4_PI * std::get<1>(field));
+		}
+	}
+
+	{
+		std::tuple<vector3D, vector3D> field;
+		if(curve->closed_form(point, field)) {
+			const vector3D& b = std::get<0>(field);
+			const vector3D& err = std::get<1>(field);
+			const double I = std::abs(curve->current);
+			return std::tuple<vector3D, vector3D>(
+				MU0_4_PI * vector3D{curve->current * get<0>(b), curve->current * get<1>(b), curve->current * get<2>(b)},
+				MU0_4_PI * vector3D{I * get<0>(err), I * get<1>(err), I * get<2>(err)});
+		}
+	}
+
+	vector3D result{0, 0, 0};
+	vector3D error{0, 0, 0};
+	Params params(curve, &point);
+	const perf::Scope perf_scope(perf::QUADRATURE);
+	QuadratureSettings settings = quadrature_at(quadrature, *curve, point);
+	if(workspace != nullptr) settings.limit = std::min(settings.limit, workspace->limit);
+
+	if(warm != nullptr && is_gauss_kronrod(settings.key)) {
+		const gsl_function fs[3] = {{&integrand<0>, &params}, {&integrand<1>, &params}, {&integrand<2>, &params}};
+		double b[3] = {0, 0, 0}, err[3] = {0, 0, 0};
+		for(unsigned k = 0; k < 3; k++) {
+			if(components[k]) {
+				(*warm)[k].set_key(settings.key);
+				b[k] = (*warm)[k].integrate(&fs[k], - curve->period/2, curve->period/2, settings.abs_error, 
+				                            settings.rel_error, settings.limit, err[k]);
+				count_integration((*warm)[k].size(), (*warm)[k].size() >= settings.limit ? GSL_EMAXITER : GSL_SUCCESS);
+			}
+		}
+		count_integrand_calls(params.nr_calls);
+		return std::tuple<vector3D, vector3D>(MU0_4_PI * vector3D{b[0], b[1], b[2]}, 
+		                                      MU0_4_PI * vector3D{err[0], err[1], err[2]});
+	}
+	const gsl_function fs[3] = {{&integrand<0>, &params}, {&integrand<1>, &params}, {&integrand<2>, &params}};
+	if(components[0]) integrate_rule(&fs[0], - curve->period/2, curve->period/2, settings, workspace, 
+	                                 get<0>(result), get<0>(error));
+	if(components[1]) integrate_rule(&fs[1], - curve->period/2, curve->period/2, settings, workspace, 
+	                                 get<1>(result), get<1>(error));
+	if(components[2]) integrate_rule(&fs[2], - curve->period/2, curve->period/2, settings, workspace, 
+	                                 get<2>(result), get<2>(error));
+	count_integrand_calls(params.nr_calls);
+
+	return std::tuple<vector3D, vector3D>(MU0_4_PI * result, MU0_4_PI * error);
+}
+
+
+// Set of conductors whose fields are superposed. A configuration with a
+// single curve is a scene with one conductor.
+class Scene {
+public:
+	std::vector<std::shared_ptr<Curve>> curves;
+	Quadrature quadrature;
+
+	// Sum of biot_savart over all conductors, evaluated with one workspace.
+	// The error is the sum of the error bounds of the conductors. warm, if
+	// given, holds the warm start integrators of every conductor.
+	std::tuple<vector3D, vector3D> field(const vector3D& point, gsl_integration_workspace* workspace,
+	                                     const std::array<bool, 3>& components = {{true, true, true}},
+	                                     std::vector<std::array<WarmStartIntegrator, 3>>* warm = nullptr) const
+	{
+		double b[3] = {0, 0, 0}, err[3] = {0, 0, 0};
+		for(std::size_t c = 0; c < curves.size(); c++) {
+			const std::tuple<vector3D, vector3D> field = biot_savart(curves[c].get(), point, workspace, components,
+			                                                         warm != nullptr ? &(*warm)[c] : nullptr, quadrature);
+			b[0] += get<0>(std::get<0>(field)); err[0] += get<0>(std::get<1>(field));
+			b[1] += get<1>(std::get<0>(field)); err[1] += get<1>(std::get<1>(field));
+			b[2] += get<2>(std::get<0>(field)); err[2] += get<2>(std::get<1>(field));
+		}
+		return std::tuple<vector3D, vector3D>(vector3D{b[0], b[1], b[2]}, vector3D{err[0], err[1], err[2]});
+	}
+
+	bool axisymmetric() const noexcept
+	{
+		for(const std::shared_ptr<Curve>& curve : curves) {
+			if(!curve->axisymmetric()) return false;
+		}
+		return true;
+	}
+
+	std::vector<double> currents() const
+	{
+		std::vector<double> result;
+		for(const std::shared_ptr<Curve>& curve : curves) result.push_back(curve->current);
+		return result;
+	}
+
+	// scene of the given conductor alone, carrying unit current
+	Scene unit(std::size_t conductor) const
+	{
+		Scene result;
+		result.curves.emplace_back(new PlacedCurve(curves[conductor], {{0, 0, 0}}, {{0, 0, 1}}, 1));
+		result.quadrature = quadrature;
+		return result;
+	}
+
+	// symmetries shared by all conductors
+	std::vector<Symmetry> symmetries() const
+	{
+		std::vector<Symmetry> result;
+		for(std::size_t i = 0; i < curves.size(); i++) {
+			const std::vector<Symmetry> group = symmetry_group(curves[i]->symmetries());
+			if(i == 0) {
+				result = group;
+				continue;
+			}
+			result.erase(std::remove_if(result.begin(), result.end(), [&](const Symmetry& s) {
+				return std::find(group.begin(), group.end(), s) == group.end();
+			}), result.end());
+		}
+		return result;
+	}
+};
+
+
+// Table of (B_rho, B_phi, B_z) for axisymmetric curves. Entries are keyed by
+// (rho, z) rounded to the given tolerance and computed on first use at the
+// point (rho, 0, z). Every other point with the same (rho, z) is then obtained
+// by rotating the stored field instead of integrating again. field() may be
+// called from several threads.
+class AxisymmetricTable {
+private:
+	struct Entry {
+		double b_rho, b_phi, b_z;
+		double err_rho, err_phi, err_z;
+	};
+	std::map<std::pair<long long, long long>, Entry> table;
+	const double tolerance;
+	mutable std::mutex mutex;   // guards table
+
+	std::pair<long long, long long> key(double rho, double z) const noexcept
+	{
+		return std::make_pair(std::llround(rho / tolerance), std::llround(z / tolerance));
+	}
+
+public:
+	AxisymmetricTable(double tolerance_) : tolerance{tolerance_} {}
+
+	std::tuple<vector3D, vector3D> field(const Scene& scene, const vector3D& point, gsl_integration_workspace* workspace)
+	{
+		const double x = get<0>(point);
+		const double y = get<1>(point);
+		const double z = get<2>(point);
+		const double rho = std::hypot(x, y);
+
+		Entry e;
+		std::unique_lock<std::mutex> lock(mutex);
+		auto it = table.find(key(rho, z));
+		if(it != table.end()) {
+			e = it->second;
+		} else {
+			// integrated without the lock; a thread that needs the same entry
+			// meanwhile integrates it as well
+			lock.unlock();
+			std::tuple<vector3D, vector3D> 
+				field = scene.field(vector3D{rho, 0, z}, workspace);
+			const vector3D& b = std::get<0>(field);
+			const vector3D& err = std::get<1>(field);
+			e = Entry{ get<0>(b), get<1>(b), get<2>(b), 
+			           get<0>(err), get<1>(err), get<2>(err) };
+			lock.lock();
+			table.emplace(key(rho, z), e);
+		}
+		lock.unlock();
+
+		const double cos_phi = rho == 0 ? 1 : x / rho;
+		const double sin_phi = rho == 0 ? 0 : y / rho;
+		return std::tuple<vector3D, vector3D>(
+			vector3D{ e.b_rho * cos_phi - e.b_phi * sin_phi, 
+			          e.b_rho * sin_phi + e.b_phi * cos_phi, 
+			          e.b_z },
+			vector3D{ std::abs(cos_phi) * e.err_rho + std::abs(sin_phi) * e.err_phi,
+			          std::abs(sin_phi) * e.err_rho + std::abs(cos_phi) * e.err_phi,
+			          e.err_z });
+	}
+
+	std::size_t size() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return table.size();
+	}
+};
+
+
+// one axis of the evaluation grid
+struct Range {
+	double min, max;
+	std::size_t nr_steps;
+	double step;
+
+	double at(std::size_t i) const noexcept { return min + i*step; }
+};
+
+// copy of the field with the components that vanish by symmetry set to zero
+inline std::tuple<vector3D, vector3D> restrict_components(const std::tuple<vector3D, vector3D>& field, 
+                                                   const std::array<bool, 3>& components)
+{
+	const vector3D& b = std::get<0>(field);
+	const vector3D& err = std::get<1>(field);
+	return std::tuple<vector3D, vector3D>(
+		vector3D{components[0] ? get<0>(b) : 0, components[1] ? get<1>(b) : 0, components[2] ? get<2>(b) : 0},
+		vector3D{components[0] ? get<0>(err) : 0, components[1] ? get<1>(err) : 0, components[2] ? get<2>(err) : 0});
+}
+
+// index of the grid point at coordinate c along one axis of the grid
+inline bool grid_index(double c, const Range& range, std::size_t& index)
+{
+	if(range.step == 0) {
+		index = 0;
+		return std::abs(c - range.min) < FIELD_SYMMETRY_TOLERANCE;
+	}
+	const long long i = std::llround((c - range.min) / range.step);
+	if(i < 0 || i >= static_cast<long long>(range.nr_steps) 
+		 || std::abs(range.at(i) - c) > FIELD_SYMMETRY_TOLERANCE)
+		return false;
+	index = static_cast<std::size_t>(i);
+	return true;
+}
+
+// Symmetry mapping grid point (i, j, k) to its image of lowest index, if that
+// is lower than the index of the point, nullptr otherwise; components is
+// cleared for the components the symmetries mapping the point to itself kill.
+inline const Symmetry* lowest_image(const std::vector<Symmetry>& symmetries, const Range& x_range, 
+                                    const Range& y_range, const Range& z_range, std::size_t i, std::size_t j,
+                                    std::size_t k, std::size_t& image, std::array<bool, 3>& components)
+{
+	const double x = x_range.at(i), y = y_range.at(j), z = z_range.at(k);
+	const std::size_t index = (i*y_range.nr_steps + j)*z_range.nr_steps + k;
+	const Symmetry* reuse = nullptr;
+	image = index;
+	for(const Symmetry& s : symmetries) {
+		std::size_t ii, jj, kk;
+		if(!grid_index(s.sx * x, x_range, ii)
+		   || !grid_index(s.sy * y, y_range, jj)
+		   || !grid_index(s.sz * z, z_range, kk))
+			continue;
+		const std::size_t other = (ii*y_range.nr_steps + jj)*z_range.nr_steps + kk;
+		if(other == index) {
+			components[0] = components[0] && !s.kills<0>();
+			components[1] = components[1] && !s.kills<1>();
+			components[2] = components[2] && !s.kills<2>();
+		} else if(other < image) {
+			reuse = &s;
+			image = other;
+		}
+	}
+	return reuse;
+}
+
+// Rough relative cost of the field at a point, for the ETA of the progress
+// report. The adaptive quadrature refines near the wire, about
+// logarithmically in the distance; points the multipole expansion covers
+// cost next to nothing.
+class CostEstimate {
+private:
+	std::vector<CurveSamples> samples;   // of every curve
+	const Scene& scene;
+
+public:
+	explicit CostEstimate(const Scene& scene_) : scene(scene_)
+	{
+		for(const std::shared_ptr<Curve>& curve : scene.curves) samples.emplace_back(*curve);
+	}
+
+	double operator()(const vector3D& point) const
+	{
+		double cost = 0;
+		for(std::size_t c = 0; c < samples.size(); c++) {
+			const Curve& curve = *scene.curves[c];
+			if(curve.multipole && curve.multipole->covers(point)) {
+				cost += 0.1;
+				continue;
+			}
+			double distance, magnitude;
+			samples[c].estimate(point, distance, magnitude);
+			cost += 1 + std::log2(1 + samples[c].get_length() / std::max(distance, curve.wireR));
+		}
+		return cost;
+	}
+
+	// estimates of the sums over the blocks of block[0] x block[1] x block[2]
+	// points of the grid, block (a, b, c) holding the points (i, j, k) with
+	// i / block[0] = a and so on, at index (a*nr_blocks[1] + b)*nr_blocks[2] + c;
+	// from at most 4096 points of the grid. Points evaluate_grid() obtains
+	// from a symmetry cost nothing.
+	std::vector<double> blocks(const Range& x_range, const Range& y_range, const Range& z_range,
+	                           const std::array<std::size_t, 3>& block) const
+	{
+		const std::array<std::size_t, 3> nr_blocks{{(x_range.nr_steps + block[0] - 1) / block[0], 
+		                                            (y_range.nr_steps + block[1] - 1) / block[1],
+		                                            (z_range.nr_steps + block[2] - 1) / block[2]}};
+		std::vector<double> sums(nr_blocks[0] * nr_blocks[1] * nr_blocks[2], 0);
+		const std::vector<Symmetry> symmetries = FIELD_SYMMETRIES ? scene.symmetries() : std::vector<Symmetry>{};
+		const std::size_t n = x_range.nr_steps * y_range.nr_steps * z_range.nr_steps;
+		const std::size_t stride = std::max<std::size_t>(1, n / 4096);
+		const double weight = n == 0 ? 0 : static_cast<double>(n) / ((n + stride - 1) / stride);
+		for(std::size_t index = 0; index < n; index += stride) {
+			const std::size_t k = index % z_range.nr_steps;
+			const std::size_t j = index / z_range.nr_steps % y_range.nr_steps;
+			const std::size_t i = index / z_range.nr_steps / y_range.nr_steps;
+			std::size_t image;
+			std::array<bool, 3> components{{true, true, true}};
+			if(lowest_image(symmetries, x_range, y_range, z_range, i, j, k, image, components) == nullptr) {
+				sums[((i / block[0])*nr_blocks[1] + j / block[1])*nr_blocks[2] + k / block[2]] 
+					+= weight * (*this)(vector3D{x_range.at(i), y_range.at(j), z_range.at(k)});
+			}
+		}
+		return sums;
+	}
+
+	// estimate of the sum over the grid
+	double total(const Range& x_range, const Range& y_range, const Range& z_range) const
+	{
+		// one block holding the whole grid
+		const std::array<std::size_t, 3> all{{std::max<std::size_t>(1, x_range.nr_steps), 
+		                                      std::max<std::size_t>(1, y_range.nr_steps),
+		                                      std::max<std::size_t>(1, z_range.nr_steps)}};
+		const std::vector<double> sum = blocks(x_range, y_range, z_range, all);
+		return sum.empty() ? 0 : sum[0];
+	}
+};
+
+// Field on the uniform grid x_range * y_range * z_range, computed in tiles
+// that may be handed to different threads; evaluate_grid() computes them all
+// in turn. The points are stored in the order they are written by
+// write_grid(), i.e. point (i, j, k) at index
+// (i*y_range.nr_steps + j)*z_range.nr_steps + k.
+//
+// With FIELD_GRID_HILBERT the tiles are cubes of FIELD_GRID_TILE_SIZE points
+// per axis, ordered along a Hilbert curve, and the points of a tile are
+// visited in snake order, so consecutive points of a run of tiles are
+// neighbours and the quadrature is warm started from the partition of the
+// previous point. Otherwise every tile is one x row, computed in the order
+// the points are stored.
+//
+// Points with an image under a symmetry of the scene, and points of an
+// axisymmetric scene with a (rho, z) already integrated, are not integrated
+// again, whichever tiles they fall in.
+class GridEvaluation {
+private:
+	// A point with an image of lower index under one of the symmetries is
+	// obtained by transforming the field at the lowest such image once all
+	// tiles are done (that image has no image of lower index, so it is
+	// computed).
+	struct Reuse {
+		std::size_t index, image;
+		const Symmetry* symmetry;
+		std::array<bool, 3> components;
+	};
+
+	const Scene& scene;
+	const Range x_range, y_range, z_range;
+	const std::array<std::size_t, 3> n;
+	const std::array<std::size_t, 3> tile;        // points per axis of a tile
+	std::vector<std::array<std::size_t, 3>> tiles;   // in traversal order
+	std::vector<double> tile_costs;                  // estimated, in the order of tiles
+	const std::vector<Symmetry> symmetries;
+	const bool use_axisymmetry;
+	AxisymmetricTable axisymmetric_table;
+	std::vector<std::tuple<vector3D, vector3D>> fields;
+	std::vector<PointCost>* costs;
+	std::vector<Reuse> reused;
+	std::mutex mutex;                                // guards reused
+
+	static std::array<std::size_t, 3> tile_size(const std::array<std::size_t, 3>& n)
+	{
+		const std::size_t size = std::max(1, FIELD_GRID_TILE_SIZE);
+		if(FIELD_GRID_HILBERT) return {{size, size, size}};
+		return {{1, std::max<std::size_t>(1, n[1]), std::max<std::size_t>(1, n[2])}};
+	}
+
+public:
+	// With costs given, it receives the work done for every point, in the
+	// order of the fields; points obtained from a symmetry cost nothing.
+	GridEvaluation(const Scene& scene_, const Range& x_range_, const Range& y_range_, const Range& z_range_,
+	               std::vector<PointCost>* costs_ = nullptr)
+		: scene(scene_), x_range(x_range_), y_range(y_range_), z_range(z_range_),
+		  n{{x_range_.nr_steps, y_range_.nr_steps, z_range_.nr_steps}},
+		  tile(tile_size(n)),
+		  symmetries(FIELD_SYMMETRIES ? scene_.symmetries() : std::vector<Symmetry>{}),
+		  use_axisymmetry(FIELD_AXISYMMETRIC && scene_.axisymmetric()),
+		  axisymmetric_table(FIELD_AXISYMMETRIC_TOLERANCE),
+		  fields(n[0] * n[1] * n[2]), costs(costs_)
+	{
+		const std::array<std::size_t, 3> nr_tiles{{(n[0] + tile[0] - 1) / tile[0], (n[1] + tile[1] - 1) / tile[1], 
+		                                           (n[2] + tile[2] - 1) / tile[2]}};
+		if(FIELD_GRID_HILBERT) {
+			tiles = hilbert_order(nr_tiles);
+		} else {
+			for(std::size_t i = 0; i < nr_tiles[0]; i++) tiles.push_back({{i, 0, 0}});
+		}
+		// the costs of all tiles are estimated up front, so that the progress
+		// costs nothing while the tiles are computed
+		const std::vector<double> blocks = CostEstimate(scene).blocks(x_range, y_range, z_range, tile);
+		for(const std::array<std::size_t, 3>& t : tiles)
+			tile_costs.push_back(blocks[(t[0]*nr_tiles[1] + t[1])*nr_tiles[2] + t[2]]);
+		if(costs != nullptr) costs->assign(fields.size(), PointCost{0, 0, 0, GSL_SUCCESS});
+	}
+
+	std::size_t nr_points() const noexcept { return fields.size(); }
+	std::size_t nr_tiles() const noexcept { return tiles.size(); }
+
+	// estimated cost of the tiles [first, last), in the units of Progress::add
+	double cost(std::size_t first, std::size_t last) const
+	{
+		return std::accumulate(tile_costs.begin() + first, tile_costs.begin() + last, 0.);
+	}
+
+	// Computes the tiles [first, last) in turn, adding every tile to progress
+	// once it is done. Calls for disjoint ranges may run concurrently.
+	void evaluate(std::size_t first, std::size_t last, Progress& progress)
+	{
+		const perf::Scope perf_scope(perf::GRID);
+		gsl_integration_workspace* workspace = gsl_integration_workspace_alloc(scene.quadrature.max_limit());
+		std::vector<std::array<WarmStartIntegrator, 3>> warm(scene.curves.size(), 
+			{{WarmStartIntegrator(FIELD_KEY), WarmStartIntegrator(FIELD_KEY), WarmStartIntegrator(FIELD_KEY)}});
+		std::vector<Reuse> own_reused;
+		std::size_t evaluations = 0;   // integrand calls not yet added to progress
+
+		auto evaluate_point = [&](std::size_t i, std::size_t j, std::size_t k) {
+			const vector3D point{x_range.at(i), y_range.at(j), z_range.at(k)};
+			const std::size_t index = (i*n[1] + j)*n[2] + k;
+
+			std::array<bool, 3> components{{true, true, true}};
+			std::size_t image;
+			const Symmetry* reuse = lowest_image(symmetries, x_range, y_range, z_range, i, j, k, image, components);
+			if(reuse != nullptr) {
+				own_reused.push_back(Reuse{index, image, reuse, components});
+				return;
+			}
+			PointCost& cost = current_cost();
+			std::chrono::steady_clock::time_point start;
+			if(costs != nullptr) {
+				cost = PointCost{0, 0, 0, GSL_SUCCESS};
+				start = std::chrono::steady_clock::now();
+			}
+			const std::size_t nr_calls = cost.integrand_calls;
+			std::tuple<vector3D, vector3D> field;
+			if(use_axisymmetry) {
+				field = axisymmetric_table.field(scene, point, workspace);
+			} else if(FIELD_GRID_HILBERT) {
+				field = scene.field(point, workspace, components, &warm);
+			} else {
+				field = scene.field(point, workspace, components);
+			}
+			fields[index] = restrict_components(field, components);
+			if(costs != nullptr) {
+				(*costs)[index] = cost;
+				(*costs)[index].microseconds 
+					= std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+			}
+			evaluations += cost.integrand_calls - nr_calls;
+		};
+
+		for(std::size_t t = first; t < last; t++) {
+			const trace::Scope scope(FIELD_GRID_HILBERT ? "tile" : "row");
+			std::size_t origin[3], size[3];
+			for(unsigned axis = 0; axis < 3; axis++) {
+				origin[axis] = tiles[t][axis] * tile[axis];
+				size[axis] = std::min(tile[axis], n[axis] - origin[axis]);
+			}
+			for(std::size_t a = 0; a < size[0]; a++) {
+				for(std::size_t b = 0; b < size[1]; b++) {
+					const std::size_t j = !FIELD_GRID_HILBERT || a % 2 == 0 ? b : size[1] - 1 - b;
+					for(std::size_t c = 0; c < size[2]; c++) {
+						const std::size_t k = !FIELD_GRID_HILBERT || (a*size[1] + b) % 2 == 0 ? c : size[2] - 1 - c;
+						evaluate_point(origin[0] + a, origin[1] + j, origin[2] + k);
+					}
+				}
+			}
+			progress.add(size[0] * size[1] * size[2], tile_costs[t], evaluations);
+			evaluations = 0;
+		}
+		gsl_integration_workspace_free(workspace);
+		std::lock_guard<std::mutex> lock(mutex);
+		reused.insert(reused.end(), own_reused.begin(), own_reused.end());
+	}
+
+	// Fills in the points obtained from a symmetry once all tiles are done
+	// and returns the fields, writing a summary to report.
+	std::vector<std::tuple<vector3D, vector3D>> finish(std::ostream& report)
+	{
+		for(const Reuse& r : reused) 
+			fields[r.index] = restrict_components(r.symmetry->apply(fields[r.image]), r.components);
+		if(!symmetries.empty()) {
+			report << "Symmetries: reused " << reused.size() << " out of " 
+				  << fields.size() << " points.\n";
+		}
+		if(use_axisymmetry) {
+			report << "Axisymmetric curve: integrated " << axisymmetric_table.size() 
+				  << " distinct (rho, z) points out of " << fields.size() << ".\n";
+		}
+		report << "\n";
+		return std::move(fields);
+	}
+};
+
+// Evaluates the field on the uniform grid x_range * y_range * z_range (see
+// GridEvaluation), in the order the points are written by write_grid().
+// Progress and statistics are written to report.
+//
+// With costs given, it receives the work done for every point, in the same
+// order; points obtained from a symmetry cost nothing. The points done are
+// added to progress, which is shared by the grids computed concurrently;
+// without it the progress is shown on report.
+inline std::vector<std::tuple<vector3D, vector3D>> evaluate_grid(const Scene& scene, const Range& x_range, 
+                                                          const Range& y_range, const Range& z_range,
+                                                          std::ostream& report = silent(),
+                                                          std::vector<PointCost>* costs = nullptr,
+                                                          Progress* progress = nullptr)
+{
+	GridEvaluation grid(scene, x_range, y_range, z_range, costs);
+	std::unique_ptr<Progress> own_progress;
+	if(progress == nullptr) {
+		own_progress.reset(new Progress(report, "Calculating field", grid.nr_points(), grid.cost(0, grid.nr_tiles()), 
+		                                report.rdbuf() != nullptr ? FIELD_PROGRESS_INTERVAL : 0));
+		progress = own_progress.get();
+	}
+	grid.evaluate(0, grid.nr_tiles(), *progress);
+	if(own_progress) own_progress->finish();
+	return grid.finish(report);
+}
+
+// Writes the grid fields computed by evaluate_grid() to outfile. Returns the
+// largest |B| on the grid.
+inline double write_grid(const Range& x_range, const Range& y_range, const Range& z_range, 
+                         const std::vector<std::tuple<vector3D, vector3D>>& fields, std::ostream& outfile)
+{
+	const trace::Scope scope("format");
+	const perf::Scope perf_scope(perf::WRITE);
+	outfile << "#x\ty\tz\tBx\tBx_err\tBy\tBy_err\tBz\tBz_err\n";
+	double max_field = 0;
+	auto field = fields.cbegin();
+	for(auto i=0; i < x_range.nr_steps; i++) {
+		double x = x_range.at(i);
+		for(auto j=0; j < y_range.nr_steps; j++) {
+			double y = y_range.at(j);
+			for(auto k=0; k < z_range.nr_steps; k++, field++) {
+				double z = z_range.at(k);
+				vector3D point{x, y, z};
+				
+				if(std::get<0>(*field).length() > max_field) 
+					max_field = std::get<0>(*field).length();
+				
+				outfile << point << '\t' 
+					<< *field << '\t' 
+					<< std::get<0>(*field).length() << '\n';
+			}
+		}
+		outfile << '\n';
+	}
+	return max_field;
+}
+
+// Writes the costs computed by evaluate_grid() to outfile in the layout of
+// write_grid(), so they plot like the field.
+inline void write_costs(const Range& x_range, const Range& y_range, const Range& z_range, 
+                        const std::vector<PointCost>& costs, std::ostream& outfile)
+{
+	const trace::Scope scope("format");
+	const perf::Scope perf_scope(perf::WRITE);
+	outfile << "#x\ty\tz\tintegrand_calls\tsubintervals\tmicroseconds\tstatus\n";
+	auto cost = costs.cbegin();
+	for(std::size_t i = 0; i < x_range.nr_steps; i++) {
+		for(std::size_t j = 0; j < y_range.nr_steps; j++) {
+			for(std::size_t k = 0; k < z_range.nr_steps; k++, cost++) {
+				outfile << x_range.at(i) << '\t' << y_range.at(j) << '\t' << z_range.at(k) << '\t'
+					<< cost->integrand_calls << '\t' << cost->subintervals << '\t' 
+					<< cost->microseconds << '\t' << cost->status << '\n';
+			}
+		}
+		outfile << '\n';
+	}
+}
+
+// Sets up the multipole expansions, tree codes and samples of the
+// conductors, writing a summary to report, and turns the GSL error handler
+// off.
+inline void prepare(Scene& scene, std::ostream& report = silent())
+{
+	gsl_set_error_handler_off();
+	// an absolute tolerance scaled per point has no meaning for the expansions
+	const double rel_error = scene.quadrature.defaults.rel_error;
+	const double abs_error = scene.quadrature.scaled_abs_error ? 0 : scene.quadrature.defaults.abs_error;
+	for(const std::shared_ptr<Curve>& curve : scene.curves) {
+		if(scene.quadrature.local()) curve->samples.reset(new CurveSamples(*curve));
+		if(FIELD_MULTIPOLE) {
+			curve->multipole.reset(new MultipoleExpansion(*curve, rel_error, abs_error, 
+			                                              FIELD_MULTIPOLE_DISTANCE, FIELD_MULTIPOLE_MAX_ORDER));
+			report << "Multipole expansion of order " << curve->multipole->get_order() 
+				  << " for points further than " << FIELD_MULTIPOLE_DISTANCE * curve->multipole->get_radius() 
+				  << " from the centre.\n";
+		}
+		if(FIELD_BARNES_HUT && curve->breakpoints().size() > FIELD_BARNES_HUT_MIN_SEGMENTS) {
+			curve->tree.reset(new BarnesHutTree(*curve, rel_error, abs_error, 
+			                                    FIELD_BARNES_HUT_ORDER, FIELD_BARNES_HUT_LEAF_SIZE));
+			report << "Barnes-Hut tree with " << curve->tree->size() << " nodes, theta = " 
+				  << curve->tree->get_theta() << ".\n";
+		}
+	}
+	report << "\n";
+}
+
+
+// Scratch memory of one thread: FieldEvaluator::evaluate may be called
+// concurrently as long as every thread passes its own workspace.
+class FieldWorkspace {
+private:
+	std::unique_ptr<gsl_integration_workspace, void (*)(gsl_integration_workspace*)> workspace;
+
+public:
+	// limit: the most intervals an integral may use, larger limits of the
+	// quadrature settings are capped to it
+	explicit FieldWorkspace(std::size_t limit = FIELD_LIMIT) 
+		: workspace(gsl_integration_workspace_alloc(limit), &gsl_integration_workspace_free) {}
+
+	gsl_integration_workspace* get() const noexcept { return workspace.get(); }
+};
+
+// Batch evaluation of the field of a scene. The constructor prepares the
+// scene (see prepare()); afterwards the evaluator is read-only.
+class FieldEvaluator {
+private:
+	Scene scene;
+
+public:
+	explicit FieldEvaluator(Scene scene_, std::ostream& report = silent()) : scene(std::move(scene_))
+	{
+		prepare(scene, report);
+	}
+
+	const Scene& get_scene() const noexcept { return scene; }
+
+	// workspace large enough for the quadrature settings of the scene
+	FieldWorkspace make_workspace() const { return FieldWorkspace(scene.quadrature.max_limit()); }
+
+	// Field at the count points (x[i], y[i], z[i]): B to (bx, by, bz) and its
+	// error estimate to (err_x, err_y, err_z). All arrays are owned by the
+	// caller and hold count values.
+	void evaluate(FieldWorkspace& workspace, std::size_t count, const double* x, const double* y, const double* z,
+	              double* bx, double* by, double* bz, double* err_x, double* err_y, double* err_z) const
+	{
+		for(std::size_t i = 0; i < count; i++) {
+			const std::tuple<vector3D, vector3D> field = scene.field(vector3D{x[i], y[i], z[i]}, workspace.get());
+			const vector3D& b = std::get<0>(field);
+			const vector3D& err = std::get<1>(field);
+			bx[i] = get<0>(b);
+			by[i] = get<1>(b);
+			bz[i] = get<2>(b);
+			err_x[i] = get<0>(err);
+			err_y[i] = get<1>(err);
+			err_z[i] = get<2>(err);
+		}
+	}
+
+	std::tuple<vector3D, vector3D> evaluate(FieldWorkspace& workspace, const vector3D& point) const
+	{
+		return scene.field(point, workspace.get());
+	}
+};
+
+#endif // FIELD_H
@@ -0,0 +1,121 @@
+#ifndef FIELD_BASIS_H
+#define FIELD_BASIS_H
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "vector3D.h"
+
+
+// Fields of every conductor of a scene for unit current, sampled at a fixed
+// list of points. Since B is linear in the currents, the field for any set of
+// currents is the linear combination sum_c I_c B_c, and its error bound is
+// sum_c |I_c| err_c.
+//
+// The samples are stored per conductor and per column (Bx, Bx_err, By, ...)
+// as contiguous arrays, so that combine() runs over plain arrays of doubles.
+class FieldBasis {
+private:
+	static const std::size_t nr_columns = 6;
+	std::size_t nr_conductors, nr_points;
+	std::vector<double> data;  // [conductor][column][point]
+
+	double* column(std::size_t conductor, std::size_t c) noexcept
+	{
+		return &data[(conductor * nr_columns + c) * nr_points];
+	}
+
+	const double* column(std::size_t conductor, std::size_t c) const noexcept
+	{
+		return &data[(conductor * nr_columns + c) * nr_points];
+	}
+
+public:
+	FieldBasis(std::size_t nr_conductors_, std::size_t nr_points_)
+		: nr_conductors{nr_conductors_}, nr_points{nr_points_},
+		  data(nr_conductors_ * nr_columns * nr_points_, 0)
+	{}
+
+	std::size_t conductors() const noexcept { return nr_conductors; }
+	std::size_t size() const noexcept { return nr_points; }
+
+	// stores the unit current fields of one conductor
+	void set(std::size_t conductor, const std::vector<std::tuple<vector3D, vector3D>>& fields)
+	{
+		for(std::size_t p = 0; p < nr_points; p++) {
+			const vector3D& b = std::get<0>(fields[p]);
+			const vector3D& err = std::get<1>(fields[p]);
+			column(conductor, 0)[p] = get<0>(b);
+			column(conductor, 1)[p] = get<0>(err);
+			column(conductor, 2)[p] = get<1>(b);
+			column(conductor, 3)[p] = get<1>(err);
+			column(conductor, 4)[p] = get<2>(b);
+			column(conductor, 5)[p] = get<2>(err);
+		}
+	}
+
+	// field for the given currents (one per conductor)
+	std::vector<std::tuple<vector3D, vector3D>> combine(const std::vector<double>& currents) const
+	{
+		std::vector<double> sum(nr_columns * nr_points, 0);
+		for(std::size_t conductor = 0; conductor < nr_conductors; conductor++) {
+			for(std::size_t c = 0; c < nr_columns; c++) {
+				// error columns add up with |I|
+				const double weight = c % 2 == 0 ? currents[conductor] : std::abs(currents[conductor]);
+				const double* src = column(conductor, c);
+				double* dst = &sum[c * nr_points];
+				for(std::size_t p = 0; p < nr_points; p++) dst[p] += weight * src[p];
+			}
+		}
+
+		std::vector<std::tuple<vector3D, vector3D>> fields;
+		fields.reserve(nr_points);
+		for(std::size_t p = 0; p < nr_points; p++) {
+			fields.emplace_back(vector3D{sum[p], sum[2*nr_points + p], sum[4*nr_points + p]},
+			                    vector3D{sum[nr_points + p], sum[3*nr_points + p], sum[5*nr_points + p]});
+		}
+		return fields;
+	}
+
+	// FNV-1a hash of a description of the geometry and sampling, used as the
+	// tag of the cache file
+	static std::uint64_t make_tag(const std::string& description) noexcept
+	{
+		std::uint64_t hash = 14695981039346656037ULL;
+		for(const char c : description) {
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	// Binary cache: a tag identifying the geometry and sampling the basis
+	// belongs to, followed by the sizes and the raw samples.
+	bool save(const std::string& path, std::uint64_t tag) const
+	{
+		std::ofstream out(path, std::ios::binary);
+		const std::uint64_t header[3] = {tag, nr_conductors, nr_points};
+		out.write(reinterpret_cast<const char*>(header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(double));
+		return out.good();
+	}
+
+	// Loads the cache at path if it was saved with the same tag and sizes.
+	bool load(const std::string& path, std::uint64_t tag)
+	{
+		std::ifstream in(path, std::ios::binary);
+		std::uint64_t header[3];
+		if(!in.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+		if(header[0] != tag || header[1] != nr_conductors || header[2] != nr_points) return false;
+		std::vector<double> cached(data.size());
+		if(!in.read(reinterpret_cast<char*>(cached.data()), cached.size() * sizeof(double))) return false;
+		data.swap(cached);
+		return true;
+	}
+};
+
+#endif // FIELD_BASIS_H
@@ -0,0 +1,31 @@
+#ifndef FIELD_CONFIGURE_H
+#define FIELD_CONFIGURE_H
+
+// Settings of the solver headers. They are prefixed since every file that
+// includes field.h sees them.
+#define FIELD_REL_ERROR 1.E-2
+#define FIELD_ABS_ERROR 1.E-5
+#define FIELD_KEY GSL_INTEG_GAUSS41
+#define FIELD_LIMIT 1000
+#define FIELD_ABS_ERROR_SCALED true
+#define FIELD_AXISYMMETRIC true
+#define FIELD_AXISYMMETRIC_TOLERANCE 1.E-12
+#define FIELD_SYMMETRIES true
+#define FIELD_SYMMETRY_TOLERANCE 1.E-12
+#define FIELD_MULTIPOLE true
+#define FIELD_MULTIPOLE_DISTANCE 3.0
+#define FIELD_MULTIPOLE_MAX_ORDER 12
+#define FIELD_BARNES_HUT true
+#define FIELD_BARNES_HUT_MIN_SEGMENTS 1000
+#define FIELD_BARNES_HUT_ORDER 4
+#define FIELD_BARNES_HUT_LEAF_SIZE 16
+#define FIELD_GRID_HILBERT true
+#define FIELD_GRID_TILE_SIZE 8
+#define FIELD_STATISTICS false
+#define FIELD_TRACE false
+#define FIELD_TRACE_BUFFER_SIZE 65536
+#define FIELD_PERF_COUNTERS false
+#define FIELD_PERF_FP_OPS_EVENT 0
+#define FIELD_PROGRESS_INTERVAL 500
+
+#endif // FIELD_CONFIGURE_H
@@ -0,0 +1,151 @@
+#ifndef FIELD_LINES_H
+#define FIELD_LINES_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+
+// Field lines are integrated as dx/ds = B/|B| (s being the arc length) with
+// the embedded Dormand-Prince 5(4) Runge-Kutta method. The step is adapted so
+// that the local error estimate stays below tolerance.
+struct FieldLineOptions {
+	double tolerance;                 // local error per step
+	double initial_step;
+	double max_step;                  // for a smooth drawing
+	double max_length;                // in each direction
+	std::size_t max_points;           // in each direction
+	std::array<double, 3> lo, hi;     // box the line must stay in; ignored along axes with lo == hi
+};
+
+using Point = std::array<double, 3>;
+
+namespace field_lines_detail {
+
+	// unit tangent direction * B/|B|; false if B can not be evaluated or vanishes
+	template<class FieldFunction>
+	bool tangent(FieldFunction& field, const Point& x, double direction, Point& t)
+	{
+		Point b;
+		if(!field(x, b)) return false;
+		const double norm = std::sqrt(b[0]*b[0] + b[1]*b[1] + b[2]*b[2]);
+		if(norm == 0) return false;
+		for(unsigned i = 0; i < 3; i++) t[i] = direction * b[i] / norm;
+		return true;
+	}
+
+	inline double distance_to_segment(const Point& p, const Point& a, const Point& b)
+	{
+		double ab2 = 0, ap_ab = 0;
+		for(unsigned i = 0; i < 3; i++) {
+			ab2 += (b[i] - a[i]) * (b[i] - a[i]);
+			ap_ab += (p[i] - a[i]) * (b[i] - a[i]);
+		}
+		const double u = ab2 == 0 ? 0 : std::min(1.0, std::max(0.0, ap_ab / ab2));
+		double d2 = 0;
+		for(unsigned i = 0; i < 3; i++) {
+			const double d = p[i] - a[i] - u * (b[i] - a[i]);
+			d2 += d * d;
+		}
+		return std::sqrt(d2);
+	}
+
+}
+
+// Traces the field line through seed along B (direction = 1) or against it
+// (direction = -1). field(x, b) sets b to B at x and returns false where B is
+// not available. The line stops when it leaves the box, reaches max_length or
+// max_points, meets a zero of B, or returns to the seed (closed is then set
+// and the seed repeated as the last point).
+template<class FieldFunction>
+std::vector<Point> trace_field_line(FieldFunction& field, const Point& seed, double direction,
+                                    const FieldLineOptions& options, bool& closed)
+{
+	using namespace field_lines_detail;
+	static const double c[7][6] = {
+		{},
+		{1./5},
+		{3./40, 9./40},
+		{44./45, -56./15, 32./9},
+		{19372./6561, -25360./2187, 64448./6561, -212./729},
+		{9017./3168, -355./33, 46732./5247, 49./176, -5103./18656},
+		{35./384, 0, 500./1113, 125./192, -2187./6784, 11./84}
+	};
+	// difference of the weights of the 5th and 4th order solutions
+	static const double e[7] = {71./57600, 0, -71./16695, 71./1920, -17253./339200, 22./525, -1./40};
+
+	std::vector<Point> line{seed};
+	closed = false;
+	Point k[7];
+	if(!tangent(field, seed, direction, k[0])) return line;
+
+	double h = options.initial_step, length = 0;
+	while(length < options.max_length && line.size() < options.max_points) {
+		const Point& x = line.back();
+		h = std::min(std::min(h, options.max_step), options.max_length - length);
+
+		bool ok = true;
+		Point y;
+		for(unsigned stage = 1; stage < 7 && ok; stage++) {
+			for(unsigned i = 0; i < 3; i++) {
+				y[i] = x[i];
+				for(unsigned j = 0; j < stage; j++) y[i] += h * c[stage][j] * k[j][i];
+			}
+			ok = tangent(field, y, direction, k[stage]);
+		}
+		if(!ok) {
+			// B not available inside the step, retry with a smaller one
+			h /= 2;
+			if(h < 1.E-12 * options.initial_step) break;
+			continue;
+		}
+
+		double error = 0;
+		for(unsigned i = 0; i < 3; i++) {
+			double ei = 0;
+			for(unsigned j = 0; j < 7; j++) ei += e[j] * k[j][i];
+			error = std::max(error, std::abs(h * ei));
+		}
+		const double factor = error == 0 ? 5 : std::min(5.0, std::max(0.2, 0.9 * std::pow(options.tolerance / error, 0.2)));
+		if(error > options.tolerance) {
+			h *= factor;
+			if(h < 1.E-12 * options.initial_step) break;
+			continue;
+		}
+
+		// y is the 5th order solution (the last stage), k[6] its tangent
+		bool inside = true;
+		for(unsigned i = 0; i < 3; i++) {
+			if(options.lo[i] < options.hi[i] && (y[i] < options.lo[i] || y[i] > options.hi[i])) inside = false;
+		}
+		if(!inside) break;
+
+		length += h;
+		// back at the seed after a few steps: the line is closed
+		if(line.size() > 4 && distance_to_segment(seed, x, y) < h / 4) {
+			line.push_back(seed);
+			closed = true;
+			break;
+		}
+		line.push_back(y);
+		k[0] = k[6];
+		h *= factor;
+	}
+	return line;
+}
+
+// Field line through seed in both directions, ordered along B.
+template<class FieldFunction>
+std::vector<Point> trace_field_line(FieldFunction& field, const Point& seed, const FieldLineOptions& options)
+{
+	bool closed;
+	std::vector<Point> forward = trace_field_line(field, seed, 1., options, closed);
+	if(closed) return forward;
+	std::vector<Point> line = trace_field_line(field, seed, -1., options, closed);
+	std::reverse(line.begin(), line.end());
+	line.insert(line.end(), forward.begin() + 1, forward.end());
+	return line;
+}
+
+#endif // FIELD_LINES_H
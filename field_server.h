@@ -0,0 +1,251 @@
+#ifndef FIELD_SERVER_H
+#define FIELD_SERVER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+extern "C" {
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+}
+
+#include "vector3D.h"
+#include "thread_pool.h"
+
+
+// Binary protocol over a Unix domain stream socket; all numbers in the byte
+// order of the host. A request is a count n (uint64) followed by the arrays
+// x[n], y[n], z[n] (double). The answer is n followed by Bx[n], By[n], Bz[n],
+// Bx_err[n], By_err[n], Bz_err[n]. n = 0 ends the connection and
+// n = FIELD_SERVER_SHUTDOWN stops the server; a larger n than the server
+// accepts per request closes the connection.
+const std::uint64_t FIELD_SERVER_SHUTDOWN = ~std::uint64_t(0);
+
+namespace field_server_detail {
+
+	inline bool read_all(int fd, void* data, std::size_t size)
+	{
+		char* p = static_cast<char*>(data);
+		while(size > 0) {
+			const ssize_t n = ::read(fd, p, size);
+			if(n < 0 && errno == EINTR) continue;
+			if(n <= 0) return false;
+			p += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	// fails (EPIPE) instead of raising SIGPIPE if the peer has gone
+	inline bool write_all(int fd, const void* data, std::size_t size)
+	{
+		const char* p = static_cast<const char*>(data);
+		while(size > 0) {
+			const ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+			if(n < 0 && errno == EINTR) continue;
+			if(n <= 0) return false;
+			p += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	inline sockaddr_un address(const std::string& path)
+	{
+		sockaddr_un result;
+		std::memset(&result, 0, sizeof(result));
+		result.sun_family = AF_UNIX;
+		std::strncpy(result.sun_path, path.c_str(), sizeof(result.sun_path) - 1);
+		return result;
+	}
+
+}
+
+// Answers field queries of any number of clients. The points of a request are
+// split into chunks of chunk_size which are evaluated on the thread pool, so
+// evaluate must be thread-safe; everything it caches (curves, expansions,
+// workspaces) stays alive between requests. A request may hold at most
+// max_points points. Every client has a thread of its own, which is joined
+// once the client has gone.
+class FieldServer {
+public:
+	using Evaluator = std::function<std::tuple<vector3D, vector3D>(const vector3D&)>;
+
+private:
+	struct Client {
+		int fd;                          // closed by run() after the thread is joined
+		std::atomic<bool> finished;
+		std::thread thread;
+	};
+
+	const std::string path;
+	Evaluator evaluate;
+	ThreadPool& pool;
+	const std::size_t chunk_size;
+	const std::size_t max_points;
+	int listener;
+	std::atomic<bool> stopping;
+
+	// evaluates the request of n points in place of its answer
+	void answer(std::size_t n, const std::vector<double>& in, std::vector<double>& out)
+	{
+		std::mutex mutex;
+		std::condition_variable done;
+		std::size_t nr_pending = (n + chunk_size - 1) / chunk_size;
+		for(std::size_t first = 0; first < n; first += chunk_size) {
+			const std::size_t last = std::min(n, first + chunk_size);
+			pool.submit([&, first, last]() {
+				for(std::size_t p = first; p < last; p++) {
+					const std::tuple<vector3D, vector3D> field = evaluate(vector3D{in[p], in[n + p], in[2*n + p]});
+					out[p] = get<0>(std::get<0>(field));
+					out[n + p] = get<1>(std::get<0>(field));
+					out[2*n + p] = get<2>(std::get<0>(field));
+					out[3*n + p] = get<0>(std::get<1>(field));
+					out[4*n + p] = get<1>(std::get<1>(field));
+					out[5*n + p] = get<2>(std::get<1>(field));
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				if(--nr_pending == 0) done.notify_one();
+			});
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&nr_pending]() { return nr_pending == 0; });
+	}
+
+	void serve_client(Client& client_)
+	{
+		using namespace field_server_detail;
+		const int client = client_.fd;
+		std::vector<double> in, out;
+		std::uint64_t n;
+		while(read_all(client, &n, sizeof(n)) && n != 0) {
+			if(n == FIELD_SERVER_SHUTDOWN) {
+				stopping = true;
+				::shutdown(listener, SHUT_RDWR);
+				break;
+			}
+			if(n > max_points) break;
+			in.resize(3 * n);
+			out.resize(6 * n);
+			if(!read_all(client, in.data(), in.size() * sizeof(double))) break;
+			answer(n, in, out);
+			if(!write_all(client, &n, sizeof(n))
+			   || !write_all(client, out.data(), out.size() * sizeof(double)))
+				break;
+		}
+		::shutdown(client, SHUT_RDWR);   // the client sees the end now, reap() closes the descriptor
+		client_.finished = true;
+	}
+
+	// joins the threads of the clients that have gone (all with every)
+	static void reap(std::vector<std::unique_ptr<Client>>& clients, bool every)
+	{
+		auto gone = std::partition(clients.begin(), clients.end(), [every](const std::unique_ptr<Client>& client) {
+			return !every && !client->finished;
+		});
+		for(auto client = gone; client != clients.end(); client++) {
+			(*client)->thread.join();
+			::close((*client)->fd);
+		}
+		clients.erase(gone, clients.end());
+	}
+
+public:
+	FieldServer(const std::string& path_, Evaluator evaluate_, ThreadPool& pool_, std::size_t chunk_size_,
+	            std::size_t max_points_)
+		: path(path_), evaluate(std::move(evaluate_)), pool(pool_), chunk_size{std::max<std::size_t>(1, chunk_size_)},
+		  max_points{max_points_}, listener{-1}, stopping{false}
+	{}
+
+	FieldServer(const FieldServer&) =delete;
+	FieldServer& operator=(const FieldServer&) =delete;
+
+	// Listens on the socket until a client sends FIELD_SERVER_SHUTDOWN, then
+	// disconnects the other clients; returns false if the socket can not be
+	// set up or accept fails for good.
+	bool run()
+	{
+		const sockaddr_un address = field_server_detail::address(path);
+		listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		::unlink(path.c_str());
+		if(listener < 0
+		   || ::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+		   || ::listen(listener, 16) != 0) {
+			if(listener >= 0) ::close(listener);
+			return false;
+		}
+
+		std::vector<std::unique_ptr<Client>> clients;
+		bool ok = true;
+		while(!stopping) {
+			const int fd = ::accept(listener, nullptr, nullptr);
+			reap(clients, false);
+			if(fd < 0) {
+				if(stopping || errno == EINTR || errno == ECONNABORTED) continue;
+				if(errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+					// out of descriptors or memory until clients go
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+					continue;
+				}
+				ok = false;
+				break;
+			}
+			clients.emplace_back(new Client);
+			Client& client = *clients.back();
+			client.fd = fd;
+			client.finished = false;
+			client.thread = std::thread(&FieldServer::serve_client, this, std::ref(client));
+		}
+		// wakes the clients waiting for a request
+		for(const std::unique_ptr<Client>& client : clients) ::shutdown(client->fd, SHUT_RDWR);
+		reap(clients, true);
+		::close(listener);
+		::unlink(path.c_str());
+		return ok;
+	}
+};
+
+
+// Client side: connects to a FieldServer, returns -1 on failure.
+inline int connect_field_server(const std::string& path)
+{
+	const sockaddr_un address = field_server_detail::address(path);
+	const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0) return -1;
+	if(::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Sends the n points (x, y, z) and receives B and its error estimate; b and
+// err hold the x, y and z components as consecutive arrays of n values.
+inline bool query_field_server(int fd, std::size_t n, const double* x, const double* y, const double* z,
+                               double* b, double* err)
+{
+	using namespace field_server_detail;
+	std::uint64_t count = n;
+	if(!write_all(fd, &count, sizeof(count))
+	   || !write_all(fd, x, n * sizeof(double))
+	   || !write_all(fd, y, n * sizeof(double))
+	   || !write_all(fd, z, n * sizeof(double)))
+		return false;
+	return read_all(fd, &count, sizeof(count)) && count == n
+	    && read_all(fd, b, 3 * n * sizeof(double)) && read_all(fd, err, 3 * n * sizeof(double));
+}
+
+#endif // FIELD_SERVER_H
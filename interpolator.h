@@ -0,0 +1,198 @@
+#ifndef INTERPOLATOR_H
+#define INTERPOLATOR_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "vector3D.h"
+
+
+// Interpolation of B between the nodes of a uniform grid, for evaluating the
+// field at many arbitrary points without any integration.
+//
+// Besides B every node stores its derivatives f_x, f_y, f_z, f_xy, f_xz, f_yz
+// and f_xyz (obtained by finite differences, in units of the grid step),
+// which is the data of tricubic Hermite interpolation: the interpolant is
+// C^1, reproduces those derivatives at the nodes and is exact for cubic
+// polynomials, so div B stays zero up to the interpolation error. Trilinear
+// interpolation only uses the values. Axes with a single node are constant.
+//
+// Points outside the grid are extrapolated from the nearest cell.
+class FieldInterpolator {
+public:
+	enum class Method {Trilinear, Tricubic};
+
+private:
+	static const unsigned nr_derivatives = 8;  // f, f_x, f_y, f_z, f_xy, f_xz, f_yz, f_xyz
+	std::array<double, 3> min, step;
+	std::array<std::size_t, 3> n;
+	std::vector<double> data;                  // [component][derivative][node]
+
+	std::size_t nr_nodes() const noexcept { return n[0] * n[1] * n[2]; }
+
+	double* values(unsigned component, unsigned derivative) noexcept
+	{
+		return &data[(component * nr_derivatives + derivative) * nr_nodes()];
+	}
+
+	const double* values(unsigned component, unsigned derivative) const noexcept
+	{
+		return &data[(component * nr_derivatives + derivative) * nr_nodes()];
+	}
+
+	// derivative of f along axis in units of the step, central differences
+	// inside and second order one-sided ones at the ends
+	void differentiate(const double* f, unsigned axis, double* df) const
+	{
+		const std::size_t stride = axis == 0 ? n[1] * n[2] : axis == 1 ? n[2] : 1;
+		const std::size_t m = n[axis];
+		for(std::size_t node = 0; node < nr_nodes(); node++) {
+			const std::size_t i = node / stride % m;
+			if(m == 1) df[node] = 0;
+			else if(m == 2) df[node] = f[node + (1 - i) * stride] - f[node - i * stride];
+			else if(i == 0) df[node] = (-3*f[node] + 4*f[node + stride] - f[node + 2*stride]) / 2;
+			else if(i == m - 1) df[node] = (3*f[node] - 4*f[node - stride] + f[node - 2*stride]) / 2;
+			else df[node] = (f[node + stride] - f[node - stride]) / 2;
+		}
+	}
+
+	// cell containing x along axis and the position u in [0, 1] inside it
+	void locate(double x, unsigned axis, std::size_t& i, double& u) const noexcept
+	{
+		if(n[axis] == 1) {
+			i = 0;
+			u = 0;
+			return;
+		}
+		const double t = (x - min[axis]) / step[axis];
+		const double cell = std::min(std::max(std::floor(t), 0.0), static_cast<double>(n[axis] - 2));
+		i = static_cast<std::size_t>(cell);
+		u = t - cell;
+	}
+
+public:
+	// empty interpolator, to be filled by load()
+	FieldInterpolator() : min{{0, 0, 0}}, step{{0, 0, 0}}, n{{0, 0, 0}} {}
+
+	// fields in the order of evaluate_grid(), i.e. node (i, j, k) at
+	// (i*n[1] + j)*n[2] + k; steps of axes with one node are ignored
+	FieldInterpolator(const std::array<double, 3>& min_, const std::array<double, 3>& step_,
+	                  const std::array<std::size_t, 3>& n_,
+	                  const std::vector<std::tuple<vector3D, vector3D>>& fields)
+		: min(min_), step(step_), n(n_), data(3 * nr_derivatives * n_[0] * n_[1] * n_[2])
+	{
+		for(std::size_t node = 0; node < nr_nodes(); node++) {
+			const vector3D& b = std::get<0>(fields[node]);
+			values(0, 0)[node] = get<0>(b);
+			values(1, 0)[node] = get<1>(b);
+			values(2, 0)[node] = get<2>(b);
+		}
+		for(unsigned c = 0; c < 3; c++) {
+			differentiate(values(c, 0), 0, values(c, 1));
+			differentiate(values(c, 0), 1, values(c, 2));
+			differentiate(values(c, 0), 2, values(c, 3));
+			differentiate(values(c, 1), 1, values(c, 4));
+			differentiate(values(c, 1), 2, values(c, 5));
+			differentiate(values(c, 2), 2, values(c, 6));
+			differentiate(values(c, 4), 2, values(c, 7));
+		}
+	}
+
+	// Interpolates B at count points given as separate coordinate arrays,
+	// writing the components to separate arrays.
+	void evaluate(Method method, std::size_t count, const double* x, const double* y, const double* z,
+	              double* bx, double* by, double* bz) const
+	{
+		double* const b[3] = {bx, by, bz};
+		for(std::size_t p = 0; p < count; p++) {
+			std::size_t cell[3];
+			double u[3];
+			locate(x[p], 0, cell[0], u[0]);
+			locate(y[p], 1, cell[1], u[1]);
+			locate(z[p], 2, cell[2], u[2]);
+
+			// weights of the value and of the derivative at both ends of the
+			// cell, per axis
+			double value_weight[3][2], slope_weight[3][2];
+			for(unsigned axis = 0; axis < 3; axis++) {
+				const double t = u[axis], t2 = t*t, t3 = t2*t;
+				if(method == Method::Trilinear) {
+					value_weight[axis][0] = 1 - t;
+					value_weight[axis][1] = t;
+					slope_weight[axis][0] = slope_weight[axis][1] = 0;
+				} else {
+					value_weight[axis][0] = 2*t3 - 3*t2 + 1;
+					value_weight[axis][1] = -2*t3 + 3*t2;
+					slope_weight[axis][0] = t3 - 2*t2 + t;
+					slope_weight[axis][1] = t3 - t2;
+				}
+			}
+
+			double sum[3] = {0, 0, 0};
+			for(unsigned corner = 0; corner < 8; corner++) {
+				const unsigned a = corner >> 2, bb = (corner >> 1) & 1, c = corner & 1;
+				const std::size_t node = ((std::min(cell[0] + a, n[0] - 1) * n[1]
+				                         + std::min(cell[1] + bb, n[1] - 1)) * n[2]
+				                         + std::min(cell[2] + c, n[2] - 1));
+				const double vx = value_weight[0][a], vy = value_weight[1][bb], vz = value_weight[2][c];
+				const double sx = slope_weight[0][a], sy = slope_weight[1][bb], sz = slope_weight[2][c];
+				const double w[nr_derivatives] = {vx*vy*vz, sx*vy*vz, vx*sy*vz, vx*vy*sz,
+				                                  sx*sy*vz, sx*vy*sz, vx*sy*sz, sx*sy*sz};
+				const unsigned used = method == Method::Trilinear ? 1 : nr_derivatives;
+				for(unsigned k = 0; k < 3; k++) {
+					for(unsigned d = 0; d < used; d++) sum[k] += w[d] * values(k, d)[node];
+				}
+			}
+			for(unsigned k = 0; k < 3; k++) b[k][p] = sum[k];
+		}
+	}
+
+	vector3D evaluate(Method method, const vector3D& point) const
+	{
+		const double x = get<0>(point), y = get<1>(point), z = get<2>(point);
+		double b[3];
+		evaluate(method, 1, &x, &y, &z, &b[0], &b[1], &b[2]);
+		return vector3D{b[0], b[1], b[2]};
+	}
+
+	// Binary file: the grid (min, step, n) followed by the node data.
+	bool save(const std::string& path) const
+	{
+		std::ofstream out(path, std::ios::binary);
+		const std::uint64_t sizes[3] = {n[0], n[1], n[2]};
+		out.write(reinterpret_cast<const char*>(min.data()), sizeof(min));
+		out.write(reinterpret_cast<const char*>(step.data()), sizeof(step));
+		out.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+		out.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(double));
+		return out.good();
+	}
+
+	// Reads a file written by save(). Returns false, leaving the interpolator
+	// untouched, if that fails.
+	bool load(const std::string& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		std::array<double, 3> new_min, new_step;
+		std::uint64_t sizes[3];
+		if(!in.read(reinterpret_cast<char*>(new_min.data()), sizeof(new_min))
+		   || !in.read(reinterpret_cast<char*>(new_step.data()), sizeof(new_step))
+		   || !in.read(reinterpret_cast<char*>(sizes), sizeof(sizes)))
+			return false;
+		std::vector<double> new_data(3 * nr_derivatives * sizes[0] * sizes[1] * sizes[2]);
+		if(!in.read(reinterpret_cast<char*>(new_data.data()), new_data.size() * sizeof(double)))
+			return false;
+		min = new_min;
+		step = new_step;
+		n = {{sizes[0], sizes[1], sizes[2]}};
+		data.swap(new_data);
+		return true;
+	}
+};
+
+#endif // INTERPOLATOR_H
@@ -1,413 +1,1335 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <map>
+#include <memory>
+#include <array>
+#include <vector>
+#include <utility>
 #include <type_traits>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
 
 #include <cmath>
 #include <cctype>
+#include <stdexcept>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <random>
 extern "C" {
 	#include <gsl/gsl_integration.h>
 	#include <gsl/gsl_math.h>
 	#include <gsl/gsl_errno.h>
 }
 
+#include <boost/filesystem.hpp>
+
 #include "gnuplot-iostream.h"
 #include "vector3D.h"
+#include "adaptive_mesh.h"
+#include "field.h"
+#include "field_basis.h"
+#include "autotune.h"
+#include "thread_pool.h"
+#include "interpolator.h"
+#include "field_lines.h"
+#include "field_server.h"
+#include "space_filling.h"
+#include "trace.h"
 #include "configure.h"
 
 
-#define LIMIT 1000
-#define MU0_4_PI 1.E-7
-
-
-std::ostream& operator <<(std::ostream& out, const std::tuple<vector3D, vector3D>& field) 
-{
-	out << get<0>(std::get<0>(field)) << '\t' << get<0>(std::get<1>(field))
-	    << '\t' << get<1>(std::get<0>(field)) << '\t' << get<1>(std::get<1>(field))
-	    << '\t' << get<2>(std::get<0>(field)) << '\t' << get<2>(std::get<1>(field));
-	return out;
-}
-
-
-
-class Curve {
-public:
-	const double current; // current through the curve
-	const double period;
-	const double wireR; 
-
-	Curve(double period_, double current_, double wireR_) : period{period_}, current{current_}, wireR{wireR_} {}
-
-	virtual vector3D diff_el(double t) const noexcept =0;
-	virtual vector3D parametrize(double t) const noexcept =0;
-	virtual ~Curve() noexcept =default;
-};
-
-
-class Circle : public Curve {
-private:
-	const double R;
-public:
-	Circle(double R_, double current_, double wireR_) : Curve{2*M_PI, current_, wireR_}, R{R_} {}
-
-	virtual vector3D parametrize(double t) const noexcept override
-	{
-		return vector3D(R * cos(t), R * sin(t), 0);
-	}
-
-	virtual vector3D diff_el(double t) const noexcept override
-	{
-		return vector3D(-R * sin(t), R * cos(t), 0);
-	}
-
-	virtual ~Circle() noexcept =default;
-
-};
-
-
-class Coil : public Curve {
-private:
-	const double R;
-	const double length;
+// error in a configuration file, what() holds the message for the user
+class ConfigError : public std::runtime_error {
 public:
-	Coil(double R_, double current_, std::size_t n, double length_, double wireR_) 
-		: Curve{n*2*M_PI, current_, wireR_}, R{R_}, length{length_}
-	{}
-
-	virtual vector3D parametrize(double t) const noexcept override
-	{
-		return vector3D(R * cos(t), R * sin(t), length * t / period);
-	}
-
-	virtual vector3D diff_el(double t) const noexcept override
-	{
-		return vector3D(-R * sin(t), R * cos(t), length / period);
-	}
-
-	virtual ~Coil() noexcept =default;
-
-};
-
-
-struct Params {
-	const Curve* curve;
-	const vector3D* point;
-
-	Params(const Curve* curve_, const vector3D* point_) : curve{curve_}, point{point_} {}
+	explicit ConfigError(const std::string& what) : std::runtime_error{what} {}
 };
 
-template<int Index>
-double integrand(double t, void* params) 
+// adds the size of the file at path to the bytes written by the thread
+void record_output(const std::string& path)
 {
-	Params* p = static_cast<Params*>(params);
-	vector3D r = *(p->point) - p->curve->parametrize(t);
-	if(r.length()==0) 
-		return 0;
-	
-	vector3D dl = p->curve->diff_el(t);
-	double cos_theta = 1.0 / (r.length() * dl.length()) * (r * dl);
-	double d_to_center = sqrt(1 - pow(cos_theta, 2)) * r.length();
-	
-	if(d_to_center < p->curve->wireR) {
-		return p->curve->current * pow(d_to_center, 2)/pow(p->curve->wireR, 2) 
-			* cross_product<Index>(dl, r) / pow(r.length(), 3.);
-	}
-	return p->curve->current 
-		* cross_product<Index>(dl, r) / pow(r.length(), 3.);
+	if(!FIELD_STATISTICS) return;
+	boost::system::error_code error;
+	const boost::uintmax_t size = boost::filesystem::file_size(path, error);
+	if(!error) statistics::add(statistics::counters().bytes_written, size);
 }
 
-
-std::tuple<vector3D, vector3D> biot_savart(Curve* curve, const vector3D &point, gsl_integration_workspace* workspace) 
+// closes outfile, which writes to path, tracing the flush to disk
+void close_output(std::ofstream& outfile, const std::string& path)
 {
-	
-	vector3D result{0, 0, 0};
-	vector3D error{0, 0, 0};
-	Params params(curve, &point);
-
-	gsl_function f = {&integrand<0>, static_cast<void*>(&params)};
-	gsl_integration_qag (	&f, - curve->period/2, curve->period/2, ABS_ERROR, REL_ERROR, LIMIT, 
-				KEY, workspace, &get<0>(result), &get<0>(error));
-	f.function = &integrand<1>;
-	gsl_integration_qag (	&f, - curve->period/2, curve->period/2, ABS_ERROR, REL_ERROR, LIMIT, 
-				KEY, workspace, &get<1>(result), &get<1>(error));
-	f.function = &integrand<2>;
-	gsl_integration_qag (	&f, - curve->period/2, curve->period/2, ABS_ERROR, REL_ERROR, LIMIT, 
-				KEY, workspace, &get<2>(result), &get<2>(error));
-
-	return std::tuple<vector3D, vector3D>(MU0_4_PI * result, MU0_4_PI * error);
+	{
+		const trace::Scope scope("flush");
+		outfile.close();
+	}
+	record_output(path);
 }
 
-
-void read_circle(std::ifstream& infile, Curve* &curve) {
+void read_circle(std::istream& infile, Curve* &curve, std::ostream& report) {
 	std::string str;
 	
 	infile >> str;				
 	if(str != "RADIUS:") {
-		std::cerr << "expected 'RADIUS:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected 'RADIUS:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
 	double radius = 0;
 	infile >> radius;
-	std::cout << "\tradius = " << radius << "\n";
+	report << "\tradius = " << radius << "\n";
 
 	infile >> str;				
 	if(str != "CURRENT:") {
-		std::cerr << "expected 'CURRENT:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected 'CURRENT:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
 	double current = 0;
 	infile >> current;
-	std::cout << "\tcurrent = " << current << "\n";
+	report << "\tcurrent = " << current << "\n";
 	
 	infile >> str;				
 	if(str != "WIRE_RADIUS:") {
-		std::cerr << "expected 'WIRE_RADIUS:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected 'WIRE_RADIUS:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
 	double wireR = 0;
 	infile >> wireR;
-	std::cout << "\twireR = " << wireR << "\n";
+	report << "\twireR = " << wireR << "\n";
 	
 	curve = new Circle(radius, current, wireR);
 }
 
-void read_coil(std::ifstream& infile, Curve* &curve) {
+void read_coil(std::istream& infile, Curve* &curve, std::ostream& report) {
 	std::string str;
 	infile >> str;				
 	if(str != "RADIUS:") {
-		std::cerr << "expected 'RADIUS:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected 'RADIUS:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
 	double radius = 0;
 	infile >> radius;
-	std::cout << "\tradius = " << radius << "\n";
+	report << "\tradius = " << radius << "\n";
 
 	infile >> str;				
 	if(str != "CURRENT:") {
-		std::cerr << "expected 'CURRENT:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected 'CURRENT:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
 	double current = 0;
 	infile >> current;
-	std::cout << "\tcurrent = " << current << "\n";
+	report << "\tcurrent = " << current << "\n";
 
 	infile >> str;				
 	if(str != "NR_TURNS:") {
-		std::cerr << "expected 'NR_TURNS:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected 'NR_TURNS:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
 	std::size_t nr_turns = 0;
 	infile >> nr_turns;
-	std::cout << "\tnr_turns = " << nr_turns << "\n";
+	report << "\tnr_turns = " << nr_turns << "\n";
 
 	infile >> str;				
 	if(str != "LENGTH:") {
-		std::cerr << "expected 'LENGTH:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected 'LENGTH:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
 	double length = 0;
 	infile >> length;
-	std::cout << "\tlength = " << length << "\n";
+	report << "\tlength = " << length << "\n";
 
 	infile >> str;				
 	if(str != "WIRE_RADIUS:") {
-		std::cerr << "expected 'WIRE_RADIUS:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected 'WIRE_RADIUS:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
 	double wireR = 0;
 	infile >> wireR;
-	std::cout << "\twireR = " << wireR << "\n";
+	report << "\twireR = " << wireR << "\n";
 	
 
 
 	curve = new Coil(radius, current, nr_turns, length, wireR);
 }
 
-void read_range(std::ifstream& infile, const std::string& pre, double& min, double& max, std::size_t& nr_steps, double& step) 
+void read_polyline(std::istream& infile, Curve* &curve, std::ostream& report) {
+	std::string str;
+	infile >> str;				
+	if(str != "FILE:") {
+		std::ostringstream message;
+		message << "expected 'FILE:', but" << str << "was found\n";
+		throw ConfigError(message.str());
+	}
+	std::string filename;
+	infile >> filename;
+	report << "\tfile = " << filename << "\n";
+
+	infile >> str;				
+	if(str != "CURRENT:") {
+		std::ostringstream message;
+		message << "expected 'CURRENT:', but" << str << "was found\n";
+		throw ConfigError(message.str());
+	}
+	double current = 0;
+	infile >> current;
+	report << "\tcurrent = " << current << "\n";
+	
+	infile >> str;				
+	if(str != "WIRE_RADIUS:") {
+		std::ostringstream message;
+		message << "expected 'WIRE_RADIUS:', but" << str << "was found\n";
+		throw ConfigError(message.str());
+	}
+	double wireR = 0;
+	infile >> wireR;
+	report << "\twireR = " << wireR << "\n";
+
+	// one vertex "x y z" per line, lines starting with '#' are skipped
+	std::ifstream vertexfile;
+	vertexfile.open(filename);
+	if(!vertexfile.is_open()) {
+		std::ostringstream message;
+		message << "could not open " << filename << "\n";
+		throw ConfigError(message.str());
+	}
+	std::vector<double> x, y, z;
+	std::string line;
+	while(std::getline(vertexfile, line)) {
+		if(line.empty() || line[0] == '#') continue;
+		std::istringstream vertex(line);
+		double vx, vy, vz;
+		if(!(vertex >> vx >> vy >> vz)) {
+			std::ostringstream message;
+			message << "could not read vertex '" << line << "' from " << filename << "\n";
+			throw ConfigError(message.str());
+		}
+		x.push_back(vx);
+		y.push_back(vy);
+		z.push_back(vz);
+	}
+	vertexfile.close();
+	if(x.size() < 2) {
+		std::ostringstream message;
+		message << filename << " must contain at least 2 vertices\n";
+		throw ConfigError(message.str());
+	}
+	report << "\tnr_segments = " << x.size() - 1 << "\n";
+
+	curve = new Polyline(std::move(x), std::move(y), std::move(z), current, wireR);
+}
+
+enum class Shape {Circle, Coil, Polyline, Scene};
+const std::map<const std::string, Shape> convert_to_shape{
+	{"CIRCLE", Shape::Circle},
+	{"COIL", Shape::Coil},
+	{"POLYLINE", Shape::Polyline},
+	{"SCENE", Shape::Scene}
+};
+
+// reads the parameters of a single curve of the given shape; throws
+// std::out_of_range for unknown shapes
+void read_curve(std::istream& infile, const std::string& shape, Curve* &curve, std::ostream& report) {
+	switch(convert_to_shape.at(shape.c_str())) {
+		case Shape::Circle:
+			report << "\tshape = " << "Shape::Circle\n";
+			read_circle(infile, curve, report);
+			break;
+		case Shape::Coil:
+			report << "\tshape = " << "Shape::Coil\n";
+			read_coil(infile, curve, report);
+			break;
+		case Shape::Polyline:
+			report << "\tshape = " << "Shape::Polyline\n";
+			read_polyline(infile, curve, report);
+			break;
+		case Shape::Scene:
+			std::ostringstream message;
+			message << "scenes can not be nested\n";
+			throw ConfigError(message.str());
+	}
+}
+
+void read_triple(std::istream& infile, const std::string& key, std::array<double, 3>& value,
+                 std::ostream& report) {
+	std::string str;
+	infile >> str;
+	if(str != key + ":") {
+		std::ostringstream message;
+		message << "expected '" << key << ":', but" << str << "was found\n";
+		throw ConfigError(message.str());
+	}
+	infile >> value[0] >> value[1] >> value[2];
+	std::string name = key;
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+	report << "\t" << name << " = " 
+		  << value[0] << " " << value[1] << " " << value[2] << "\n";
+}
+
+// NR_CURVES: <n> followed by n blocks "SHAPE: <shape> <parameters> 
+// POSITION: <x y z> AXIS: <x y z>"
+void read_scene(std::istream& infile, Scene& scene, std::ostream& report) {
+	std::string str;
+	infile >> str;
+	if(str != "NR_CURVES:") {
+		std::ostringstream message;
+		message << "expected 'NR_CURVES:', but" << str << "was found\n";
+		throw ConfigError(message.str());
+	}
+	std::size_t nr_curves = 0;
+	infile >> nr_curves;
+	report << "\tnr_curves = " << nr_curves << "\n";
+
+	for(std::size_t i = 0; i < nr_curves; i++) {
+		infile >> str;
+		if(str != "SHAPE:") {
+			std::ostringstream message;
+			message << "expected 'SHAPE:', but" << str << "was found\n";
+			throw ConfigError(message.str());
+		}
+		infile >> str;
+		Curve* curve = nullptr;
+		read_curve(infile, str, curve, report);
+		// owned before the placement is read, which may throw
+		const std::shared_ptr<const Curve> shape(curve);
+		std::array<double, 3> position, axis;
+		read_triple(infile, "POSITION", position, report);
+		read_triple(infile, "AXIS", axis, report);
+		scene.curves.emplace_back(new PlacedCurve(shape, position, axis, shape->current));
+	}
+}
+
+
+void read_range(std::istream& infile, const std::string& pre, Range& range, std::ostream& report) 
 {
 	std::string str;
 	infile >> str;
 	if(str != pre + "_MIN:") {
-		std::cerr << "expected '"<< pre << "_MIN:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected '"<< pre << "_MIN:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
-	infile >> min;
-	std::cout << '\t' << static_cast<char>(tolower(pre[0])) << "_min = " << min << "\n";
+	infile >> range.min;
+	report << '\t' << static_cast<char>(tolower(pre[0])) << "_min = " << range.min << "\n";
 
 	infile >> str;
 	if(str != pre + "_MAX:") {
-		std::cerr << "expected '"<< pre << "_MAX:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected '"<< pre << "_MAX:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
-	infile >> max;
-	std::cout << '\t' << static_cast<char>(tolower(pre[0])) << "_max = " << max << "\n";
+	infile >> range.max;
+	report << '\t' << static_cast<char>(tolower(pre[0])) << "_max = " << range.max << "\n";
 
 	infile >> str;
 	if(str != pre + "_NR_STEPS:") {
-		std::cerr << "expected '"<< pre << "NR_STEPS:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected '"<< pre << "NR_STEPS:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
-	infile >> nr_steps;
-	if(nr_steps == 1) {
-		min = (min + max) / 2.;
-		step = 0;
+	infile >> range.nr_steps;
+	if(range.nr_steps == 1) {
+		range.min = (range.min + range.max) / 2.;
+		range.step = 0;
 	} else {
-		step = (max - min) / (nr_steps-1);
+		range.step = (range.max - range.min) / (range.nr_steps-1);
 	}
-	std::cout << '\t' << static_cast<char>(tolower(pre[0])) << "_nr_steps = " << nr_steps << "\n";
+	report << '\t' << static_cast<char>(tolower(pre[0])) << "_nr_steps = " << range.nr_steps << "\n";
 }
 
 
-enum class Shape {Circle, Coil};
-const std::map<const std::string, Shape> convert_to_shape{
-	{"CIRCLE", Shape::Circle},
-	{"COIL", Shape::Coil}
-};
-
-
-
-
-int main() 
+// Quadrature settings read from path, the defaults of the solver if there is
+// no such file. Every line is "LABEL: value", with the labels REL_ERROR,
+// ABS_ERROR, ABS_ERROR_SCALED (0 or 1), KEY (the number of points of the
+// Gauss-Kronrod rule: 15, 21, 31, 41, 51 or 61, or QAGS or CQUAD) and LIMIT. A line "REGION: min_distance max_distance" starts the overrides for
+// the points at that distance from the wire; its settings start from the
+// defaults above it. main() reads QUADRATURE_CONFIG once and hands it to
+// every configuration.
+Quadrature read_quadrature(const char* path, std::ostream& report)
 {
-	std::ifstream infile;
-	infile.open(CONFIG);
-	if(!infile.is_open()) {
-		std::cerr << "could not open " << CONFIG << "\n"
-			  << "terminating...\n";
+	Quadrature result;
+	std::ifstream infile(path);
+	std::string line;
+	QuadratureSettings* settings = &result.defaults;
+	while(std::getline(infile, line)) {
+		if(line.empty() || line[0] == '#') continue;
+		std::istringstream values(line);
+		std::string label;
+		values >> label;
+		bool ok = true;
+		if(label == "REL_ERROR:") {
+			ok = static_cast<bool>(values >> settings->rel_error) && settings->rel_error >= 0;
+		} else if(label == "ABS_ERROR:") {
+			ok = static_cast<bool>(values >> settings->abs_error) && settings->abs_error >= 0;
+		} else if(label == "ABS_ERROR_SCALED:") {
+			ok = static_cast<bool>(values >> result.scaled_abs_error);
+		} else if(label == "KEY:") {
+			std::string rule;
+			values >> rule;
+			settings->key = rule_key(rule);
+			ok = settings->key != 0;
+		} else if(label == "LIMIT:") {
+			ok = static_cast<bool>(values >> settings->limit) && settings->limit > 0;
+		} else if(label == "REGION:") {
+			QuadratureRegion region{0, 0, result.defaults};
+			ok = static_cast<bool>(values >> region.min_distance >> region.max_distance) 
+			     && region.min_distance < region.max_distance;
+			result.regions.push_back(region);
+			settings = &result.regions.back().settings;
+		} else {
+			ok = false;
+		}
+		if(!ok) {
+			std::ostringstream message;
+			message << "could not read '" << line << "' in " << path << "\n";
+			throw ConfigError(message.str());
+		}
+	}
+	if(infile.is_open()) {
+		report << "Read the quadrature settings from " << path << ": " 
+			  << result.regions.size() << " region(s).\n";
 	}
+	return result;
+}
 
-	std::cout << "Reading " << CONFIG << " ...\n";
+// contents of config.txt
+struct Config {
+	Scene scene;
+	Range x_range, y_range, z_range;
+	double max_len;
+	int format;     // 0: vectors, 1: color map of |B|, 2: color map of the cost
+};
+
+// quadrature: the settings of QUADRATURE_CONFIG, see read_quadrature()
+void read_config(std::istream& infile, Config& config, const Quadrature& quadrature, std::ostream& report) {
 	std::string str;
 	infile >> str;
 	if(str != "SHAPE:") {
-		std::cerr << "expected 'SHAPE:', but" << str << "was found\n"
-			  << "terminating...\n";
-		infile.close();
-		exit(1);
+		std::ostringstream message;
+		message << "expected 'SHAPE:', but" << str << "was found\n";
+		throw ConfigError(message.str());
 	}
 
-	Curve* curve = nullptr;
 	infile >> str;
-	double max_len;
-	std::size_t x_nr_steps, y_nr_steps, z_nr_steps;
-	double x_min, x_max, x_step;
-	double y_min, y_max, y_step;
-	double z_min, z_max, z_step;
-	bool format;
 	try{
-		switch(convert_to_shape.at(str.c_str())) {
-			case Shape::Circle:
-				std::cout << "\tshape = " << "Shape::Circle\n";
-				read_circle(infile, curve);
-				break;
-			case Shape::Coil:
-				std::cout << "\tshape = " << "Shape::Coil\n";
-				read_coil(infile, curve);
-				break;
+		if(convert_to_shape.at(str.c_str()) == Shape::Scene) {
+			report << "\tshape = " << "Shape::Scene\n";
+			read_scene(infile, config.scene, report);
+		} else {
+			Curve* curve = nullptr;
+			read_curve(infile, str, curve, report);
+			config.scene.curves.emplace_back(curve);
 		}
-		read_range(infile, "X", x_min, x_max, x_nr_steps, x_step);
-		read_range(infile, "Y", y_min, y_max, y_nr_steps, y_step);
-		read_range(infile, "Z", z_min, z_max, z_nr_steps, z_step);
+		read_range(infile, "X", config.x_range, report);
+		read_range(infile, "Y", config.y_range, report);
+		read_range(infile, "Z", config.z_range, report);
 
 		infile>>str;
 		if(str != "MAX_LEN:") {
-			std::cerr << "expected 'MAX_LEN:', but" << str << "was found\n"
-				  << "terminating...\n";
-			infile.close();
-			exit(1);
+			std::ostringstream message;
+			message << "expected 'MAX_LEN:', but" << str << "was found\n";
+			throw ConfigError(message.str());
 		}
-		infile >> max_len;
-		std::cout << "\tmax_len = " << max_len << "\n";
+		infile >> config.max_len;
+		report << "\tmax_len = " << config.max_len << "\n";
 
 		infile>>str;
 		if(str != "FORMAT:") {
-			std::cerr << "expected 'FORMAT:', but" << str << "was found\n"
+			std::ostringstream message;
+			message << "expected 'FORMAT:', but" << str << "was found\n";
+			throw ConfigError(message.str());
+		}
+		infile >> config.format;
+		if(config.format < 0 || config.format > 2) {
+			std::ostringstream message;
+			message << "FORMAT must be 0, 1 or 2, but " << config.format << " was found\n";
+			throw ConfigError(message.str());
+		}
+		report << "\tformat = " << config.format << "\n";
+
+		config.scene.quadrature = quadrature;
+
+	} catch(const std::out_of_range& e) {
+		std::ostringstream message;
+		message << e.what() << "\n"
+			<< "Unknown shape '" << str << "'\n";
+		throw ConfigError(message.str());
+	}
+}
+
+// Everything the unit current fields on the grid depend on: the tolerances,
+// the switches of field_configure.h that change how the grid is evaluated,
+// the grid and the geometry of every conductor (sampled along the curve and
+// at its kinks).
+std::string basis_description(const Scene& scene, const Range& x_range, const Range& y_range, const Range& z_range)
+{
+	std::ostringstream out;
+	out.precision(17);
+	out << scene.quadrature.description() << '\n'
+	    << FIELD_AXISYMMETRIC << ' ' << FIELD_AXISYMMETRIC_TOLERANCE << ' ' << FIELD_SYMMETRIES << ' ' << FIELD_SYMMETRY_TOLERANCE << '\n'
+	    << FIELD_MULTIPOLE << ' ' << FIELD_MULTIPOLE_DISTANCE << ' ' << FIELD_MULTIPOLE_MAX_ORDER << '\n'
+	    << FIELD_BARNES_HUT << ' ' << FIELD_BARNES_HUT_MIN_SEGMENTS << ' ' << FIELD_BARNES_HUT_ORDER << ' ' << FIELD_BARNES_HUT_LEAF_SIZE << '\n'
+	    << FIELD_GRID_HILBERT << ' ' << FIELD_GRID_TILE_SIZE << '\n';
+	for(const Range* range : {&x_range, &y_range, &z_range})
+		out << range->min << ' ' << range->max << ' ' << range->nr_steps << '\n';
+	for(const std::shared_ptr<Curve>& curve : scene.curves) {
+		out << curve->period << ' ' << curve->wireR << '\n';
+		std::vector<double> ts = curve->breakpoints();
+		const std::size_t nr_samples = 256;
+		for(std::size_t i = 0; i < nr_samples; i++)
+			ts.push_back(curve->period * (i / static_cast<double>(nr_samples) - 0.5));
+		for(double t : ts) out << curve->parametrize(t) << '\n';
+	}
+	return out.str();
+}
+
+// Unit current fields of all conductors on the grid, read from BASIS_DAT if
+// it holds them for the same geometry and grid and computed (and saved)
+// otherwise. With costs given the fields are always computed, and costs
+// receives the work done for every point, summed over the conductors.
+FieldBasis grid_basis(const Scene& scene, const Range& x_range, const Range& y_range, const Range& z_range,
+                      std::vector<PointCost>* costs = nullptr)
+{
+	FieldBasis basis(scene.curves.size(), x_range.nr_steps * y_range.nr_steps * z_range.nr_steps);
+	const std::uint64_t tag = FieldBasis::make_tag(basis_description(scene, x_range, y_range, z_range));
+	if(costs == nullptr && basis.load(BASIS_DAT, tag)) {
+		std::cout << "Read the unit current fields of " << basis.conductors() 
+			  << " conductor(s) from " << BASIS_DAT << ".\n\n";
+		return basis;
+	}
+	if(costs != nullptr) costs->assign(basis.size(), PointCost{0, 0, 0, GSL_SUCCESS});
+	for(std::size_t c = 0; c < scene.curves.size(); c++) {
+		Scene unit = scene.unit(c);
+		prepare(unit, std::cout);
+		std::vector<PointCost> unit_costs;
+		basis.set(c, evaluate_grid(unit, x_range, y_range, z_range, std::cout, costs != nullptr ? &unit_costs : nullptr));
+		for(std::size_t n = 0; n < unit_costs.size(); n++) {
+			PointCost& cost = (*costs)[n];
+			cost.integrand_calls += unit_costs[n].integrand_calls;
+			cost.subintervals += unit_costs[n].subintervals;
+			cost.microseconds += unit_costs[n].microseconds;
+			if(cost.status == GSL_SUCCESS) cost.status = unit_costs[n].status;
+		}
+	}
+	if(!basis.save(BASIS_DAT, tag)) {
+		std::cerr << "Could not write " << BASIS_DAT << "\n";
+	}
+	record_output(BASIS_DAT);
+	return basis;
+}
+
+// Sets the quadrature rule of scene by distance to the wire to the fastest
+// one on the grid (see autotune()), read from AUTOTUNE_DAT if it was chosen
+// before for the same settings, geometry and grid and saved there otherwise.
+void autotune_quadrature(Scene& scene, const Range& x_range, const Range& y_range, const Range& z_range)
+{
+	std::ostringstream description;
+	description << "autotune " << AUTOTUNE_CLASSES << ' ' << AUTOTUNE_SAMPLES << '\n'
+	            << basis_description(scene, x_range, y_range, z_range);
+	const std::uint64_t tag = FieldBasis::make_tag(description.str());
+	std::vector<AutotuneClass> classes;
+	if(load_autotune(AUTOTUNE_DAT, tag, classes)) {
+		std::cout << "Read the quadrature rules from " << AUTOTUNE_DAT << ":\n";
+	} else {
+		std::cout << "Timing the quadrature rules...\n";
+		classes = autotune(scene, x_range, y_range, z_range, std::cout);
+		if(!save_autotune(AUTOTUNE_DAT, tag, classes)) {
+			std::cerr << "Could not write " << AUTOTUNE_DAT << "\n";
+		}
+		record_output(AUTOTUNE_DAT);
+		std::cout << "Chose the quadrature rules:\n";
+	}
+	for(const AutotuneClass& c : classes) {
+		std::cout << "\tdistance [" << c.min_distance << ", " << c.max_distance << "): " 
+			  << rule_name(c.key) << "\n";
+	}
+	std::cout << "\n";
+	apply_autotune(scene.quadrature, classes);
+}
+
+// Sets of currents, one per line with a value per conductor; lines starting
+// with '#' are ignored. Returns no sets if the file does not exist.
+std::vector<std::vector<double>> read_currents(const char* path, std::size_t nr_conductors)
+{
+	std::vector<std::vector<double>> sets;
+	std::ifstream infile(path);
+	std::string line;
+	while(std::getline(infile, line)) {
+		if(line.empty() || line[0] == '#') continue;
+		std::istringstream values(line);
+		std::vector<double> currents(nr_conductors);
+		for(double& current : currents) values >> current;
+		if(!values) {
+			std::cerr << "expected " << nr_conductors << " currents in " << path << ", but '" 
+				  << line << "' was found\n"
 				  << "terminating...\n";
-			infile.close();
 			exit(1);
 		}
-		infile >> format;
-		std::cout << "\tformat = " << format << "\n";
+		sets.push_back(currents);
+	}
+	return sets;
+}
 
-	} catch(const std::out_of_range& e) {
-		std::cerr << e.what() << "\n";
-		std::cerr << "Unknown shape '" << str << "'\n"
+// Samples the field adaptively inside the box spanned by the ranges (see
+// AdaptiveMesh). The cell hierarchy is written to MESH_DAT and the flattened
+// list of sampled points to outfile. Returns the largest |B| found.
+double compute_adaptive(const Scene& scene, const Range& x_range, const Range& y_range, const Range& z_range, 
+                        std::ostream& outfile)
+{
+	std::cout << "Calculating field adaptively..." << std::flush;
+	gsl_integration_workspace* workspace = gsl_integration_workspace_alloc(scene.quadrature.max_limit());
+	AxisymmetricTable axisymmetric_table(FIELD_AXISYMMETRIC_TOLERANCE);
+	const bool use_axisymmetry = FIELD_AXISYMMETRIC && scene.axisymmetric();
+
+	AdaptiveMesh mesh({{x_range.min, y_range.min, z_range.min}}, 
+	                  {{x_range.nr_steps == 1 ? x_range.min : x_range.max, 
+	                    y_range.nr_steps == 1 ? y_range.min : y_range.max, 
+	                    z_range.nr_steps == 1 ? z_range.min : z_range.max}},
+	                  ADAPTIVE_BASE_STEPS, ADAPTIVE_MAX_DEPTH, ADAPTIVE_MAX_POINTS, ADAPTIVE_TOLERANCE);
+	mesh.refine([&](const vector3D& point) {
+		return use_axisymmetry 
+			? axisymmetric_table.field(scene, point, workspace)
+			: scene.field(point, workspace);
+	});
+	gsl_integration_workspace_free(workspace);
+	std::cout << " Done, " << mesh.size() << " points (uniform grid: " 
+		  << x_range.nr_steps * y_range.nr_steps * z_range.nr_steps << ").\n\n";
+
+	std::ofstream meshfile;
+	meshfile.open(MESH_DAT);
+	mesh.write_cells(meshfile);
+	close_output(meshfile, MESH_DAT);
+
+	double max_field = 0;
+	outfile << "#x\ty\tz\tBx\tBx_err\tBy\tBy_err\tBz\tBz_err\n";
+	for(std::size_t i = 0; i < mesh.size(); i++) {
+		const std::tuple<vector3D, vector3D>& field = mesh.get_fields()[i];
+		max_field = std::max(max_field, std::get<0>(field).length());
+		outfile << mesh.get_points()[i] << '\t' 
+			<< field << '\t' 
+			<< std::get<0>(field).length() << '\n';
+	}
+	return max_field;
+}
+
+
+// Builds the interpolator of the grid fields, saves it to INTERPOLATOR_DAT
+// and compares it to the direct evaluation at INTERPOLATION_CHECKS cell
+// centres (chosen at random), next to the quadrature error estimates.
+void check_interpolation(const Scene& scene, const Range& x_range, const Range& y_range, const Range& z_range, 
+                         const std::vector<std::tuple<vector3D, vector3D>>& fields)
+{
+	const FieldInterpolator interpolator({{x_range.min, y_range.min, z_range.min}},
+	                                     {{x_range.step, y_range.step, z_range.step}},
+	                                     {{x_range.nr_steps, y_range.nr_steps, z_range.nr_steps}}, fields);
+	if(!interpolator.save(INTERPOLATOR_DAT)) {
+		std::cerr << "Could not write " << INTERPOLATOR_DAT << "\n";
+	}
+	record_output(INTERPOLATOR_DAT);
+
+	double max_field = 0;
+	std::vector<double> quadrature_errors;
+	for(const std::tuple<vector3D, vector3D>& field : fields) {
+		max_field = std::max(max_field, std::get<0>(field).length());
+		quadrature_errors.push_back(std::get<1>(field).length());
+	}
+	if(INTERPOLATION_CHECKS == 0 || max_field == 0) return;
+
+	// largest and median value, relative to max |B|
+	auto summary = [max_field](std::vector<double>& errors) {
+		std::sort(errors.begin(), errors.end());
+		std::ostringstream out;
+		out << "max " << errors.back() / max_field << ", median " << errors[errors.size() / 2] / max_field;
+		return out.str();
+	};
+
+	std::mt19937 generator(1);
+	const Range* ranges[3] = {&x_range, &y_range, &z_range};
+	std::vector<double> xs[3];
+	for(std::size_t n = 0; n < INTERPOLATION_CHECKS; n++) {
+		for(unsigned axis = 0; axis < 3; axis++) {
+			const Range& range = *ranges[axis];
+			if(range.nr_steps == 1) {
+				xs[axis].push_back(range.min);
+				continue;
+			}
+			std::uniform_int_distribution<std::size_t> cell(0, range.nr_steps - 2);
+			xs[axis].push_back(range.at(cell(generator)) + range.step / 2);
+		}
+	}
+
+	std::vector<double> b[2][3];
+	const FieldInterpolator::Method methods[2] = {FieldInterpolator::Method::Trilinear, 
+	                                              FieldInterpolator::Method::Tricubic};
+	for(unsigned m = 0; m < 2; m++) {
+		for(std::vector<double>& component : b[m]) component.resize(INTERPOLATION_CHECKS);
+		interpolator.evaluate(methods[m], INTERPOLATION_CHECKS, xs[0].data(), xs[1].data(), xs[2].data(),
+		                      b[m][0].data(), b[m][1].data(), b[m][2].data());
+	}
+
+	std::vector<double> errors[2];
+	gsl_integration_workspace* workspace = gsl_integration_workspace_alloc(scene.quadrature.max_limit());
+	for(std::size_t n = 0; n < INTERPOLATION_CHECKS; n++) {
+		const std::tuple<vector3D, vector3D> field = scene.field(vector3D{xs[0][n], xs[1][n], xs[2][n]}, workspace);
+		const vector3D& exact = std::get<0>(field);
+		for(unsigned m = 0; m < 2; m++) {
+			const vector3D difference{b[m][0][n] - get<0>(exact), b[m][1][n] - get<1>(exact), b[m][2][n] - get<2>(exact)};
+			errors[m].push_back(difference.length());
+		}
+	}
+	gsl_integration_workspace_free(workspace);
+
+	std::cout << "Interpolator saved to " << INTERPOLATOR_DAT << ". Errors relative to max |B| at " 
+		  << INTERPOLATION_CHECKS << " cell centres:\n"
+		  << "\ttrilinear: " << summary(errors[0]) << "\n"
+		  << "\ttricubic: " << summary(errors[1]) << "\n"
+		  << "\tquadrature (estimates on the grid): " << summary(quadrature_errors) << "\n\n";
+}
+
+// Points, one "x y z" per line; lines starting with '#' are ignored. Returns
+// no points if the file does not exist.
+std::vector<Point> read_points(std::istream& infile, const std::string& name)
+{
+	std::vector<Point> points;
+	std::string line;
+	while(std::getline(infile, line)) {
+		if(line.empty() || line[0] == '#') continue;
+		std::istringstream values(line);
+		Point point;
+		if(!(values >> point[0] >> point[1] >> point[2])) {
+			std::cerr << "could not read point '" << line << "' from " << name << "\n"
+				  << "terminating...\n";
+			exit(1);
+		}
+		points.push_back(point);
+	}
+	return points;
+}
+
+std::vector<Point> read_points(const char* path)
+{
+	std::ifstream infile(path);
+	return read_points(infile, path);
+}
+
+// Traces the field lines through the points of SEEDS_DAT in parallel and
+// writes them to FIELD_LINES_DAT, one block per line. B comes from the
+// interpolator of the grid fields if FIELD_LINES_INTERPOLATED is set (and
+// the uniform grid was computed), otherwise it is computed directly with
+// warm started quadrature. Returns false if there are no seeds.
+bool trace_field_lines(const Scene& scene, const Range& x_range, const Range& y_range, const Range& z_range, 
+                       const std::vector<std::tuple<vector3D, vector3D>>& fields)
+{
+	const std::vector<Point> seeds = read_points(SEEDS_DAT);
+	if(seeds.empty()) return false;
+
+	const bool interpolated = FIELD_LINES_INTERPOLATED && !fields.empty();
+	std::unique_ptr<const FieldInterpolator> interpolator;
+	if(interpolated) {
+		interpolator.reset(new FieldInterpolator({{x_range.min, y_range.min, z_range.min}},
+		                                         {{x_range.step, y_range.step, z_range.step}},
+		                                         {{x_range.nr_steps, y_range.nr_steps, z_range.nr_steps}}, fields));
+	}
+
+	FieldLineOptions options;
+	options.lo = {{x_range.at(0), y_range.at(0), z_range.at(0)}};
+	options.hi = {{x_range.at(x_range.nr_steps - 1), y_range.at(y_range.nr_steps - 1), z_range.at(z_range.nr_steps - 1)}};
+	double diagonal = 0;
+	for(unsigned i = 0; i < 3; i++) diagonal += (options.hi[i] - options.lo[i]) * (options.hi[i] - options.lo[i]);
+	diagonal = std::sqrt(diagonal);
+	options.tolerance = FIELD_LINES_TOLERANCE * diagonal;
+	options.initial_step = 1.E-3 * diagonal;
+	options.max_step = 1.E-2 * diagonal;
+	options.max_length = FIELD_LINES_MAX_LENGTH * diagonal;
+	options.max_points = FIELD_LINES_MAX_POINTS;
+
+	std::cout << "Tracing " << seeds.size() << " field lines (" 
+		  << (interpolated ? "interpolated" : "direct") << " field) ..." << std::flush;
+	std::vector<std::vector<Point>> lines(seeds.size());
+	{
+		ThreadPool pool(NR_THREADS);
+		for(std::size_t n = 0; n < seeds.size(); n++) {
+			pool.submit([&, n]() {
+				if(interpolated) {
+					auto field = [&interpolator](const Point& x, Point& b) {
+						interpolator->evaluate(FieldInterpolator::Method::Tricubic, 1, &x[0], &x[1], &x[2], 
+						                       &b[0], &b[1], &b[2]);
+						return true;
+					};
+					lines[n] = trace_field_line(field, seeds[n], options);
+					return;
+				}
+				// consecutive points of a line are close, so the quadrature
+				// partitions are carried from one to the next
+				gsl_integration_workspace* workspace = gsl_integration_workspace_alloc(scene.quadrature.max_limit());
+				std::vector<std::array<WarmStartIntegrator, 3>> warm(scene.curves.size(), 
+					{{WarmStartIntegrator(FIELD_KEY), WarmStartIntegrator(FIELD_KEY), WarmStartIntegrator(FIELD_KEY)}});
+				auto field = [&](const Point& x, Point& b) {
+					const vector3D B = std::get<0>(scene.field(vector3D{x[0], x[1], x[2]}, workspace, 
+					                                           {{true, true, true}}, &warm));
+					b = {{get<0>(B), get<1>(B), get<2>(B)}};
+					return true;
+				};
+				lines[n] = trace_field_line(field, seeds[n], options);
+				gsl_integration_workspace_free(workspace);
+			});
+		}
+		pool.wait();
+	}
+
+	std::ofstream outfile;
+	outfile.open(FIELD_LINES_DAT);
+	std::size_t nr_points = 0;
+	for(const std::vector<Point>& line : lines) {
+		for(const Point& x : line) outfile << x[0] << '\t' << x[1] << '\t' << x[2] << '\n';
+		outfile << '\n';
+		nr_points += line.size();
+	}
+	close_output(outfile, FIELD_LINES_DAT);
+	std::cout << " Done, " << nr_points << " points saved to " << FIELD_LINES_DAT << ".\n\n";
+	return true;
+}
+
+// Parameter sweep: every line "KEY: min max nr_steps" of SWEEP_CONFIG varies
+// the value following KEY: in config.txt (in every conductor of a scene).
+// The variants are all combinations of the steps.
+struct SweepParameter {
+	std::string key;
+	Range range;
+};
+
+// Returns no parameters if the file does not exist.
+std::vector<SweepParameter> read_sweep(const char* path)
+{
+	const char* const integer_keys[] = {"NR_TURNS:", "NR_CURVES:", "X_NR_STEPS:", "Y_NR_STEPS:", "Z_NR_STEPS:", 
+	                                    "FORMAT:"};
+	std::vector<SweepParameter> parameters;
+	std::ifstream infile(path);
+	std::string line;
+	while(std::getline(infile, line)) {
+		if(line.empty() || line[0] == '#') continue;
+		std::istringstream values(line);
+		SweepParameter parameter;
+		Range& range = parameter.range;
+		if(!(values >> parameter.key >> range.min >> range.max >> range.nr_steps) 
+		   || parameter.key.back() != ':' || range.nr_steps == 0) {
+			std::cerr << "expected 'KEY: min max nr_steps' in " << path << ", but '" 
+				  << line << "' was found\n"
+				  << "terminating...\n";
+			exit(1);
+		}
+		range.step = range.nr_steps == 1 ? 0 : (range.max - range.min) / (range.nr_steps - 1);
+		// counts must stay integral at every step
+		const bool integral = std::find(std::begin(integer_keys), std::end(integer_keys), parameter.key) 
+			!= std::end(integer_keys);
+		auto whole = [](double value) { return std::abs(value - std::round(value)) < 1.E-9; };
+		if(integral && !(whole(range.min) && whole(range.max) && whole(range.step))) {
+			std::cerr << parameter.key << " takes integer values, but '" << line << "' in " << path 
+				  << " does not have integer min, max and step\n"
+				  << "terminating...\n";
+			exit(1);
+		}
+		parameters.push_back(parameter);
+	}
+	return parameters;
+}
+
+// Text of config.txt (given as its tokens) for the given variant of the
+// sweep; description receives the swept values.
+std::string sweep_variant(const std::vector<std::string>& tokens, const std::vector<SweepParameter>& parameters,
+                          std::size_t variant, std::string& description)
+{
+	std::map<std::string, std::string> values;
+	std::ostringstream summary;
+	for(const SweepParameter& parameter : parameters) {
+		const double value = parameter.range.at(variant % parameter.range.nr_steps);
+		variant /= parameter.range.nr_steps;
+		// integral values are written as such, so that counts can be swept
+		std::ostringstream text;
+		text.precision(15);
+		if(std::abs(value - std::round(value)) < 1.E-9) text << std::llround(value);
+		else text << value;
+		values[parameter.key] = text.str();
+		summary << ' ' << parameter.key << ' ' << text.str();
+	}
+	description = summary.str();
+
+	std::string result;
+	for(std::size_t i = 0; i < tokens.size(); i++) {
+		result += tokens[i] + '\n';
+		auto it = values.find(tokens[i]);
+		if(it != values.end() && i + 1 < tokens.size()) {
+			result += it->second + '\n';
+			i++;
+		}
+	}
+	return result;
+}
+
+// Evaluates all variants of the sweep on a thread pool and writes them to
+// SWEEP_DAT, one block (gnuplot index) per variant.
+void run_sweep(const std::vector<SweepParameter>& parameters, const Quadrature& quadrature)
+{
+	std::ifstream infile(CONFIG);
+	if(!infile.is_open()) {
+		std::cerr << "could not open " << CONFIG << "\n"
 			  << "terminating...\n";
 		exit(1);
 	}
+	std::vector<std::string> tokens;
+	std::string token;
+	while(infile >> token) tokens.push_back(token);
 	infile.close();
+
+	std::size_t nr_variants = 1;
+	for(const SweepParameter& parameter : parameters) {
+		if(std::find(tokens.begin(), tokens.end(), parameter.key) == tokens.end()) {
+			std::cerr << "swept parameter " << parameter.key << " does not appear in " << CONFIG << "\n"
+				  << "terminating...\n";
+			exit(1);
+		}
+		nr_variants *= parameter.range.nr_steps;
+	}
+
+	// only the first variant is echoed while reading
+	std::vector<Config> configs(nr_variants);
+	std::vector<std::string> descriptions(nr_variants);
+	std::cout << "Reading " << CONFIG << " ...\n";
+	for(std::size_t v = 0; v < nr_variants; v++) {
+		std::istringstream text(sweep_variant(tokens, parameters, v, descriptions[v]));
+		try {
+			read_config(text, configs[v], quadrature, v == 0 ? std::cout : silent());
+		} catch(const ConfigError& e) {
+			std::cerr << "variant " << v << ":" << descriptions[v] << "\n" 
+				  << e.what() << "terminating...\n";
+			exit(1);
+		}
+	}
 	std::cout << "Done reading.\n\n";
-	
+
+	std::vector<std::vector<std::tuple<vector3D, vector3D>>> results(nr_variants);
+	{
+		ThreadPool pool(NR_THREADS);
+		std::cout << "Calculating " << nr_variants << " variants on " << pool.size() << " threads.\n";
+		std::size_t nr_points = 0;
+		double total_cost = 0;
+		for(const Config& config : configs) {
+			nr_points += config.x_range.nr_steps * config.y_range.nr_steps * config.z_range.nr_steps;
+			total_cost += CostEstimate(config.scene).total(config.x_range, config.y_range, config.z_range);
+		}
+		Progress progress(std::cout, "Calculating variants", nr_points, total_cost, FIELD_PROGRESS_INTERVAL);
+		for(std::size_t v = 0; v < nr_variants; v++) {
+			pool.submit([&configs, &results, &progress, v]() {
+				Config& config = configs[v];
+				prepare(config.scene, silent());
+				results[v] = evaluate_grid(config.scene, config.x_range, config.y_range, config.z_range, 
+				                           silent(), nullptr, &progress);
+			});
+		}
+		pool.wait();
+		progress.finish();
+		std::cout << "\n";
+	}
+
+	std::ofstream outfile;
+	outfile.open(SWEEP_DAT);
+	for(std::size_t v = 0; v < nr_variants; v++) {
+		if(v > 0) outfile << '\n';
+		outfile << "# variant " << v << ":" << descriptions[v] << '\n';
+		write_grid(configs[v].x_range, configs[v].y_range, configs[v].z_range, results[v], outfile);
+	}
+	close_output(outfile, SWEEP_DAT);
+	std::cout << "Saved " << nr_variants << " variants to " << SWEEP_DAT << ".\n";
+}
+
+
+
+// Batch mode: every configuration file named on the command line, and every
+// *.txt file in a directory named there (except SWEEP_CONFIG and
+// QUADRATURE_CONFIG), is a job. The grid of a job is split into runs of
+// BATCH_TILES consecutive tiles of its GridEvaluation, which run on a shared
+// thread pool, cheapest jobs first; the symmetries and the axisymmetric table
+// still span the whole grid. The field of a job is written next to its
+// configuration file (coil.txt -> coil.field.dat) as soon as its last run of
+// tiles is done.
+struct Job {
+	std::string path;
+	std::string output;
+	Config config;
+	double cost;
+	std::unique_ptr<GridEvaluation> grid;
+	std::atomic<std::size_t> nr_pending;   // runs of tiles not finished yet
+	std::chrono::steady_clock::time_point start;
+};
+
+// Rough cost of a job in units of one integration over one turn of a curve:
+// the number of grid points times the work per point, which grows with the
+// length of smooth curves and with the number of segments of polylines
+// (logarithmically once the tree code takes over).
+double estimate_cost(const Config& config)
+{
+	double per_point = 0;
+	for(const std::shared_ptr<Curve>& curve : config.scene.curves) {
+		const std::size_t nr_segments = curve->breakpoints().size();
+		if(nr_segments == 0) 
+			per_point += curve->period / (2*M_PI);
+		else if(FIELD_BARNES_HUT && nr_segments > FIELD_BARNES_HUT_MIN_SEGMENTS)
+			per_point += FIELD_BARNES_HUT_LEAF_SIZE * std::log2(nr_segments) / 100.;
+		else
+			per_point += nr_segments / 100.;
+	}
+	return per_point * config.x_range.nr_steps * config.y_range.nr_steps * config.z_range.nr_steps;
+}
+
+// configuration files named by the arguments, directories expanded
+std::vector<std::string> batch_files(int argc, char* argv[])
+{
+	namespace fs = boost::filesystem;
+	std::vector<std::string> files;
+	for(int i = 1; i < argc; i++) {
+		const fs::path path(argv[i]);
+		if(!fs::is_directory(path)) {
+			files.push_back(path.string());
+			continue;
+		}
+		std::vector<std::string> entries;
+		for(fs::directory_iterator it(path); it != fs::directory_iterator(); ++it) {
+			// the sweep and quadrature settings that sit next to a configuration
+			const std::string name = it->path().filename().string();
+			if(fs::is_regular_file(it->path()) && it->path().extension() == ".txt" 
+			   && name != SWEEP_CONFIG && name != QUADRATURE_CONFIG)
+				entries.push_back(it->path().string());
+		}
+		std::sort(entries.begin(), entries.end());
+		files.insert(files.end(), entries.begin(), entries.end());
+	}
+	return files;
+}
+
+void run_batch(const std::vector<std::string>& files, const Quadrature& quadrature)
+{
+	std::vector<std::unique_ptr<Job>> jobs;
+	std::cout << "Reading " << files.size() << " configuration files ...\n";
+	for(const std::string& file : files) {
+		std::unique_ptr<Job> job(new Job);
+		job->path = file;
+		job->output = boost::filesystem::path(file).replace_extension(".field.dat").string();
+		std::ifstream infile(file);
+		if(!infile.is_open()) {
+			std::cerr << "could not open " << file << ", skipping it\n";
+			continue;
+		}
+		try {
+			read_config(infile, job->config, quadrature, silent());
+		} catch(const ConfigError& e) {
+			std::cerr << file << ":\n" << e.what() << "skipping it\n";
+			continue;
+		}
+		prepare(job->config.scene, silent());
+		job->cost = estimate_cost(job->config);
+		std::cout << '\t' << file << ": estimated cost " << job->cost << "\n";
+		jobs.push_back(std::move(job));
+	}
+	std::cout << "Done reading.\n\n";
+
+	std::atomic<std::size_t> nr_done{0};
+	ThreadPool pool(NR_THREADS);
+	std::cout << "Running " << jobs.size() << " jobs on " << pool.size() << " threads.\n";
+	std::size_t nr_points = 0;
+	double total_cost = 0;
+	for(const std::unique_ptr<Job>& job : jobs) {
+		const Config& config = job->config;
+		job->grid.reset(new GridEvaluation(config.scene, config.x_range, config.y_range, config.z_range));
+		nr_points += job->grid->nr_points();
+		total_cost += job->grid->cost(0, job->grid->nr_tiles());
+	}
+	Progress progress(std::cout, "Running jobs", nr_points, total_cost, FIELD_PROGRESS_INTERVAL);
+	for(const std::unique_ptr<Job>& pointer : jobs) {
+		Job& job = *pointer;
+		const std::size_t nr_tiles = job.grid->nr_tiles();
+		const std::size_t nr_runs = (nr_tiles + BATCH_TILES - 1) / BATCH_TILES;
+		job.nr_pending = nr_runs;
+		job.start = std::chrono::steady_clock::now();
+
+		for(std::size_t run = 0; run < nr_runs; run++) {
+			const std::size_t first = run * BATCH_TILES;
+			const std::size_t last = std::min<std::size_t>(nr_tiles, first + BATCH_TILES);
+			pool.submit([&job, &progress, &nr_done, &jobs, first, last]() {
+				job.grid->evaluate(first, last, progress);
+				if(--job.nr_pending > 0) return;
+
+				const Config& config = job.config;
+				const std::vector<std::tuple<vector3D, vector3D>> fields = job.grid->finish(silent());
+				job.grid.reset();
+				std::ofstream outfile(job.output);
+				write_grid(config.x_range, config.y_range, config.z_range, fields, outfile);
+				close_output(outfile, job.output);
+				const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - job.start;
+				std::ostringstream message;
+				message << "[" << ++nr_done << "/" << jobs.size() << "] " << job.path << " -> " 
+					<< job.output << " (" << elapsed.count() << " s)";
+				progress.message(message.str());
+			}, -job.cost);
+		}
+	}
+	pool.wait();
+	progress.finish();
+	std::cout << "Done.\n";
+}
+
+
+// Field at arbitrary points, in the order of points. The points are
+// evaluated in chunks of POINTS_CHUNK_SIZE consecutive points along a Morton
+// curve, so every chunk is compact and its quadrature partitions are warm
+// started from one point to the next.
+std::vector<std::tuple<vector3D, vector3D>> evaluate_points(const Scene& scene, const std::vector<Point>& points)
+{
+	const std::vector<std::size_t> order = morton_order(points);
+	std::vector<std::tuple<vector3D, vector3D>> fields(points.size());
+	// estimated cost of every chunk, from at most 4096 points
+	const CostEstimate estimate(scene);
+	const std::size_t stride = std::max<std::size_t>(1, points.size() / 4096);
+	std::vector<double> chunk_costs((order.size() + POINTS_CHUNK_SIZE - 1) / POINTS_CHUNK_SIZE, 0);
+	for(std::size_t n = 0; n < order.size(); n += stride) {
+		const Point& x = points[order[n]];
+		chunk_costs[n / POINTS_CHUNK_SIZE] += stride * estimate(vector3D{x[0], x[1], x[2]});
+	}
+	Progress progress(std::cout, "Calculating field", points.size(), 
+	                  std::accumulate(chunk_costs.begin(), chunk_costs.end(), 0.), FIELD_PROGRESS_INTERVAL);
+
+	ThreadPool pool(NR_THREADS);
+	for(std::size_t first = 0; first < order.size(); first += POINTS_CHUNK_SIZE) {
+		const std::size_t last = std::min(order.size(), first + POINTS_CHUNK_SIZE);
+		pool.submit([&, first, last]() {
+			FieldWorkspace workspace(scene.quadrature.max_limit());
+			std::vector<std::array<WarmStartIntegrator, 3>> warm(scene.curves.size(), 
+				{{WarmStartIntegrator(FIELD_KEY), WarmStartIntegrator(FIELD_KEY), WarmStartIntegrator(FIELD_KEY)}});
+			const trace::Scope scope("chunk");
+			const std::size_t nr_calls = current_cost().integrand_calls;
+			for(std::size_t n = first; n < last; n++) {
+				const Point& x = points[order[n]];
+				fields[order[n]] = scene.field(vector3D{x[0], x[1], x[2]}, workspace.get(), {{true, true, true}}, &warm);
+			}
+			progress.add(last - first, chunk_costs[first / POINTS_CHUNK_SIZE], current_cost().integrand_calls - nr_calls);
+		});
+	}
+	pool.wait();
+	progress.finish();
+	return fields;
+}
+
+// Point cloud mode: B at the points read from path ("-" for the standard
+// input), written to FIELD_DAT in the order they were given.
+void run_points(Scene& scene, const std::string& path)
+{
+	std::vector<Point> points;
+	if(path == "-") {
+		points = read_points(std::cin, "standard input");
+	} else {
+		std::ifstream infile(path);
+		if(!infile.is_open()) {
+			std::cerr << "could not open " << path << "\n"
+				  << "terminating...\n";
+			exit(1);
+		}
+		points = read_points(infile, path);
+	}
+
+	std::cout << "Read " << points.size() << " points.\n";
+	const std::vector<std::tuple<vector3D, vector3D>> fields = statistics::timed("field", [&]() {
+		prepare(scene, std::cout);
+		return evaluate_points(scene, points);
+	});
+
+	const statistics::Phase phase("output");
 	std::ofstream outfile;
 	outfile.open(FIELD_DAT);
-	
 	outfile << "#x\ty\tz\tBx\tBx_err\tBy\tBy_err\tBz\tBz_err\n";
-	int percent_done = 0;
-	std::cout << "\rCalculating field: " << percent_done << "%" << std::flush;
+	{
+		const trace::Scope scope("format");
+		const perf::Scope perf_scope(perf::WRITE);
+		for(std::size_t n = 0; n < points.size(); n++) {
+			const Point& x = points[n];
+			outfile << x[0] << '\t' << x[1] << '\t' << x[2] << '\t' 
+				<< fields[n] << '\t' << std::get<0>(fields[n]).length() << '\n';
+		}
+	}
+	close_output(outfile, FIELD_DAT);
+	std::cout << "Saved the field to " << FIELD_DAT << ".\n";
+}
+
+// Daemon mode: answers point queries for the curve of config.txt on a Unix
+// domain socket (see FieldServer) until a client asks it to stop.
+void run_server(Scene scene, const std::string& path)
+{
+	const FieldEvaluator evaluator(std::move(scene), std::cout);
+	ThreadPool pool(NR_THREADS);
+	FieldServer server(path, [&evaluator](const vector3D& point) {
+		// one workspace per pool thread, kept for the lifetime of the thread
+		static thread_local FieldWorkspace workspace(evaluator.make_workspace());
+		return evaluator.evaluate(workspace, point);
+	}, pool, SERVER_CHUNK_SIZE, SERVER_MAX_POINTS);
+	std::cout << "Serving on " << path << " with " << pool.size() << " threads.\n" << std::flush;
+	if(!server.run()) {
+		std::cerr << "could not listen on " << path << "\n"
+			  << "terminating...\n";
+		exit(1);
+	}
+	std::cout << "Server stopped.\n";
+}
+
+int main(int argc, char* argv[]) 
+{
+	// a failed integral shows in its error estimate (and the statistics)
+	// instead of aborting the run
+	gsl_set_error_handler_off();
+	const statistics::Report statistics_report(FIELD_STATISTICS ? STATISTICS_JSON : "");
+	const trace::Report trace_report(FIELD_TRACE ? TRACE_JSON : "");
+
+	const bool serve = argc > 1 && std::string(argv[1]) == "--serve";
+	const bool point_cloud = argc > 1 && std::string(argv[1]) == "--points";
+	Quadrature quadrature;
+	try {
+		const statistics::Phase phase("config");
+		quadrature = read_quadrature(QUADRATURE_CONFIG, std::cout);
+	} catch(const ConfigError& e) {
+		std::cerr << e.what() << "terminating...\n";
+		exit(1);
+	}
+	if(argc > 1 && !serve && !point_cloud) {
+		const statistics::Phase phase("batch");
+		run_batch(batch_files(argc, argv), quadrature);
+		return 0;
+	}
+
+	const std::vector<SweepParameter> sweep = read_sweep(SWEEP_CONFIG);
+	if(!serve && !point_cloud && !sweep.empty()) {
+		const statistics::Phase phase("sweep");
+		run_sweep(sweep, quadrature);
+		return 0;
+	}
+
+	std::ifstream infile;
+	infile.open(CONFIG);
+	if(!infile.is_open()) {
+		std::cerr << "could not open " << CONFIG << "\n"
+			  << "terminating...\n";
+	}
+
+	std::cout << "Reading " << CONFIG << " ...\n";
+	Config config;
+	try {
+		const statistics::Phase phase("config");
+		read_config(infile, config, quadrature, std::cout);
+	} catch(const ConfigError& e) {
+		std::cerr << e.what() << "terminating...\n";
+		exit(1);
+	}
+	Scene& scene = config.scene;
+	const Range& x_range = config.x_range;
+	const Range& y_range = config.y_range;
+	const Range& z_range = config.z_range;
+	infile.close();
+	std::cout << "Done reading.\n\n";
+
+	if(serve) {
+		run_server(scene, argc > 2 ? argv[2] : SERVER_SOCKET);
+		return 0;
+	}
+	if(point_cloud) {
+		run_points(scene, argc > 2 ? argv[2] : "-");
+		return 0;
+	}
+
+	if(AUTOTUNE) {
+		const statistics::Phase phase("autotune");
+		autotune_quadrature(scene, x_range, y_range, z_range);
+	}
+
+	std::ofstream outfile;
+	outfile.open(FIELD_DAT);
 	double max_field = 0;
-	gsl_integration_workspace* workspace = gsl_integration_workspace_alloc(LIMIT);
-	
-	for(auto i=0; i < x_nr_steps; i++) {
-		double x = x_min + i*x_step;
-		for(auto j=0; j < y_nr_steps; j++) {
-			double y = y_min + j*y_step;
-			for(auto k=0; k < z_nr_steps; k++) {
-				double z = z_min + k*z_step;
-				vector3D point{x, y, z};
-				std::tuple<vector3D, vector3D> 
-					field = biot_savart(curve, point, workspace);
-				
-				if(std::get<0>(field).length() > max_field) 
-					max_field = std::get<0>(field).length();
-				
-				outfile << point << '\t' 
-					<< field << '\t' 
-					<< std::get<0>(field).length() << '\n';
-			}
+	std::vector<std::tuple<vector3D, vector3D>> fields;  // on the uniform grid
+	// the cost map is computed on the grid only
+	const bool cost_map = (COST_MAP || config.format == 2) && !ADAPTIVE_MESH;
+	std::vector<PointCost> costs;
+	if(BASIS_CACHE && !ADAPTIVE_MESH) {
+		// every set of currents is written as a separate block (gnuplot index)
+		std::vector<std::vector<double>> current_sets = read_currents(CURRENTS_DAT, scene.curves.size());
+		if(current_sets.empty()) current_sets.push_back(scene.currents());
+		const FieldBasis basis = statistics::timed("field", [&]() {
+			return grid_basis(scene, x_range, y_range, z_range, cost_map ? &costs : nullptr);
+		});
+		for(std::size_t n = 0; n < current_sets.size(); n++) {
+			const std::vector<std::tuple<vector3D, vector3D>> set_fields
+				= statistics::timed("field", [&]() { return basis.combine(current_sets[n]); });
+			const statistics::Phase phase("output");
+			if(n > 0) outfile << '\n';
+			max_field = std::max(max_field, write_grid(x_range, y_range, z_range, set_fields, outfile));
 		}
-		percent_done = std::round(100 * (i+1) / static_cast<double>(x_nr_steps));
-		std::cout << "\rCalculating field: " << percent_done << "%" << std::flush;
-		outfile << '\n';
+		fields = statistics::timed("field", [&]() { return basis.combine(scene.currents()); });
+		// grid_basis only prepares the conductors alone, while the interpolation
+		// check and the field lines evaluate scene directly
+		const statistics::Phase phase("field");
+		prepare(scene, std::cout);
+	} else if(ADAPTIVE_MESH) {
+		const statistics::Phase phase("field");
+		prepare(scene, std::cout);
+		max_field = compute_adaptive(scene, x_range, y_range, z_range, outfile);
+	} else {
+		fields = statistics::timed("field", [&]() {
+			prepare(scene, std::cout);
+			return evaluate_grid(scene, x_range, y_range, z_range, std::cout, cost_map ? &costs : nullptr);
+		});
+		const statistics::Phase phase("output");
+		max_field = write_grid(x_range, y_range, z_range, fields, outfile);
+	}
+	close_output(outfile, FIELD_DAT);
+	if(cost_map) {
+		const statistics::Phase phase("output");
+		std::ofstream costfile(COST_DAT);
+		write_costs(x_range, y_range, z_range, costs, costfile);
+		close_output(costfile, COST_DAT);
+		std::cout << "Saved the cost of every point to " << COST_DAT << ".\n\n";
 	}
-	gsl_integration_workspace_free(workspace);
-	std::cout << "\rCalculating field: 100%.\n\n";
-	outfile.close();
 
-	std::cout << "Saving the curve to " << CURVE_DAT << " ...\n";
-	outfile.open(CURVE_DAT);
-	for(double t = - curve->period/2; t <= curve->period/2 ;t += 1.E-2*curve->period/z_nr_steps) {
-		outfile << curve->parametrize(t) << std::endl;
+	if(INTERPOLATOR && !ADAPTIVE_MESH) {
+		const statistics::Phase phase("interpolation");
+		check_interpolation(scene, x_range, y_range, z_range, fields);
 	}
-	outfile.close();
-	delete curve;
-	std::cout << "Done saving.\n\n";
+	const bool field_lines = statistics::timed("field_lines", [&]() {
+		return trace_field_lines(scene, x_range, y_range, z_range, fields);
+	});
 
-	
+	{
+		const statistics::Phase phase("curve");
+		std::cout << "Saving the curve to " << CURVE_DAT << " ...\n";
+		outfile.open(CURVE_DAT);
+		for(const std::shared_ptr<Curve>& curve : scene.curves) {
+			for(double t = - curve->period/2; t <= curve->period/2 ;t += 1.E-2*curve->period/z_range.nr_steps) {
+				outfile << curve->parametrize(t) << std::endl;
+			}
+			outfile << '\n';
+		}
+		close_output(outfile, CURVE_DAT);
+		std::cout << "Done saving.\n\n";
+	}
+
+	if(config.format == 2 && !cost_map) {
+		std::cerr << "FORMAT 2 needs the cost map, which is not computed with ADAPTIVE_MESH.\n";
+		return 0;
+	}
+	const statistics::Phase phase("plot");
+	const trace::Scope scope("gnuplot");
 	Gnuplot gp;
-	switch(format){
-		case false:
+	switch(config.format){
+		case 0:
 			gp << "set terminal wxt size 2400,1200\n"
 			   << "set xlabel 'x[m]' font ',20'\n"
 			   << "set ylabel 'z[m]' font ',20'\n"
@@ -416,14 +1338,17 @@ int main()
 			   << "set key font ',20'\n"
 			   << "set key below\n";
 			
-			gp << "plot[" << x_min << ":" << x_max << "]" 
-				<<"[" << z_min << ":" << z_max << "] "
-				<<"'"<< FIELD_DAT << "' using 1:3:(" << max_len / max_field <<" * $4)"
-						   << ":(" << max_len / max_field <<" * $8) with vectors "
+			gp << "plot[" << x_range.min << ":" << x_range.max << "]" 
+				<<"[" << z_range.min << ":" << z_range.max << "] "
+				<<"'"<< FIELD_DAT << "' index 0 using 1:3:(" << config.max_len / max_field <<" * $4)"
+						   << ":(" << config.max_len / max_field <<" * $8) with vectors "
 				<<"lc rgb 'dark-green' title 'field', "
-				<< "'" << CURVE_DAT <<"' using 1:3 with lines lc rgb '#FF763A' title 'curve'\n";
+				<< "'" << CURVE_DAT <<"' using 1:3 with lines lc rgb '#FF763A' title 'curve'";
+			if(field_lines) 
+				gp << ", '" << FIELD_LINES_DAT << "' using 1:3 with lines lc rgb 'blue' title 'field lines'";
+			gp << "\n";
 			break;
-		case true:
+		case 1:
 			gp << "set terminal wxt size 2400,1200\n"
 			   << "set xlabel 'x[m]' font ',20'\n"
 			   << "set ylabel 'z[m]' font ',20'\n"
@@ -435,12 +1360,37 @@ int main()
 
 			gp << "set pm3d\n"
 			   << "set pm3d map\n";
-			gp << "splot[" << x_min << ":" << x_max << "]" 
-				<< "[" << z_min << ":" << z_max << "] "
-				<< "'" << FIELD_DAT << "' using 1:3:10 notitle, "
-				<< "'' using 1:3:(" << y_min << "):(" << max_len / 10.0 <<" * $4/$10):(" << max_len / 10.0 <<" * $8/$10):(" << y_min << ") "
+			gp << "splot[" << x_range.min << ":" << x_range.max << "]" 
+				<< "[" << z_range.min << ":" << z_range.max << "] "
+				<< "'" << FIELD_DAT << "' index 0 using 1:3:10 " 
+				<< (ADAPTIVE_MESH ? "with points pt 5 ps 0.5 palette " : "") << "notitle, "
+				<< "'' index 0 using 1:3:(" << y_range.min << "):(" << config.max_len / 10.0 <<" * $4/$10):(" << config.max_len / 10.0 <<" * $8/$10):(" << y_range.min << ") "
 					<< "with vectors lt 1 lw 2 lc rgb 'dark-green' title 'direction of the field', "
-				<< "'" << CURVE_DAT <<"' using 1:3:(" << y_min << ") with lines lt 1 lw 2 lc rgb '#FF763A' title 'curve'\n";
+				<< "'" << CURVE_DAT <<"' using 1:3:(" << y_range.min << ") with lines lt 1 lw 2 lc rgb '#FF763A' title 'curve'";
+			if(field_lines) 
+				gp << ", '" << FIELD_LINES_DAT << "' using 1:3:(" << y_range.min 
+				   << ") with lines lt 1 lw 2 lc rgb 'blue' title 'field lines'";
+			gp << "\n";
+			break;
+		case 2:
+			gp << "set terminal wxt size 2400,1200\n"
+			   << "set xlabel 'x[m]' font ',20'\n"
+			   << "set ylabel 'z[m]' font ',20'\n"
+			   << "set xtics font ',20'\n"
+			   << "set ytics font ',20'\n"
+			   << "set cbtics font ',20'\n"
+			   << "set cblabel 'time per point [us]' font ',20'\n"
+			   << "set key font ',20'\n"
+			   << "set key below\n";
+
+			gp << "set pm3d\n"
+			   << "set pm3d map\n"
+			   << "set logscale cb\n";
+			gp << "splot[" << x_range.min << ":" << x_range.max << "]" 
+				<< "[" << z_range.min << ":" << z_range.max << "] "
+				<< "'" << COST_DAT << "' using 1:3:($6 > 0 ? $6 : 1/0) notitle, "
+				<< "'" << CURVE_DAT <<"' using 1:3:(" << y_range.min << ") with lines lt 1 lw 2 lc rgb '#FF763A' title 'curve'";
+			gp << "\n";
 			break;
 	}
 
@@ -0,0 +1,244 @@
+#ifndef MULTIPOLE_H
+#define MULTIPOLE_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+extern "C" {
+	#include <gsl/gsl_integration.h>
+}
+
+#include "vector3D.h"
+
+
+// Cartesian Taylor expansion of the Biot-Savart kernel. With R = x - c and
+// s = x' - c for some centre c,
+//
+//     (R - s)_k / |R - s|^3 = sum_a (a_k + 1) T_{a + e_k}(R) s^a,
+//
+// where T_a(R) are the Taylor coefficients of 1/|R - s| in s, which obey the
+// recurrence of Duan & Krasny. A set of current elements enters only through
+// the moments M_{j,a} = sum I dl_j s^a. The series converges geometrically
+// with ratio |s| / |R|.
+//
+// TaylorTable holds the multi-indices a up to a given order (sorted by |a|)
+// and the operations on moments; the moments themselves are stored by the
+// user as 3 * nr_moments() doubles, M_{j,a} at 3 * position(a) + j.
+class TaylorTable {
+public:
+	// largest supported order, bounds the scratch space used by field()
+	static const unsigned max_order = 16;
+
+private:
+	unsigned order;
+	std::vector<std::array<unsigned, 3>> indices;  // up to order + 1
+	std::vector<std::size_t> lookup;               // (a0, a1, a2) -> position in indices
+
+public:
+	TaylorTable(unsigned order_) : order{std::min(order_, max_order)}
+	{
+		const std::size_t n = order + 2;
+		lookup.assign(n * n * n, 0);
+		for(unsigned degree = 0; degree <= order + 1; degree++) {
+			for(unsigned a0 = degree + 1; a0-- > 0; ) {
+				for(unsigned a1 = degree - a0 + 1; a1-- > 0; ) {
+					const unsigned a2 = degree - a0 - a1;
+					lookup[(a0 * n + a1) * n + a2] = indices.size();
+					indices.push_back({{a0, a1, a2}});
+				}
+			}
+		}
+	}
+
+	unsigned get_order() const noexcept { return order; }
+
+	std::size_t position(unsigned a0, unsigned a1, unsigned a2) const noexcept
+	{
+		const std::size_t n = order + 2;
+		return lookup[(a0 * n + a1) * n + a2];
+	}
+
+	// number of multi-indices with |a| <= order
+	std::size_t nr_moments() const noexcept { return position(0, 0, order) + 1; }
+
+	// adds a current element I dl = w located at s (relative to the centre)
+	void accumulate(const double s[3], const double w[3], double* moments) const
+	{
+		double powers[3][max_order + 1];
+		for(unsigned i = 0; i < 3; i++) {
+			powers[i][0] = 1;
+			for(unsigned n = 1; n <= order; n++) powers[i][n] = powers[i][n-1] * s[i];
+		}
+		const std::size_t n = nr_moments();
+		for(std::size_t m = 0; m < n; m++) {
+			const std::array<unsigned, 3>& a = indices[m];
+			const double monomial = powers[0][a[0]] * powers[1][a[1]] * powers[2][a[2]];
+			for(unsigned j = 0; j < 3; j++) moments[3*m + j] += w[j] * monomial;
+		}
+	}
+
+	// Field of the moments at R (relative to the centre). b receives the
+	// full truncated series and last the terms with |a| = order.
+	void field(const double* moments, const double R[3], double b[3], double last[3]) const
+	{
+		const double r2 = R[0]*R[0] + R[1]*R[1] + R[2]*R[2];
+		double T[(max_order + 2) * (max_order + 3) * (max_order + 4) / 6];
+		T[0] = 1 / std::sqrt(r2);
+		for(std::size_t m = 1; m < indices.size(); m++) {
+			const std::array<unsigned, 3>& a = indices[m];
+			const unsigned degree = a[0] + a[1] + a[2];
+			double sum1 = 0, sum2 = 0;
+			for(unsigned i = 0; i < 3; i++) {
+				std::array<unsigned, 3> c = a;
+				if(c[i] >= 1) {
+					c[i] -= 1;
+					sum1 += R[i] * T[position(c[0], c[1], c[2])];
+				}
+				if(c[i] >= 1) {
+					c[i] -= 1;
+					sum2 += T[position(c[0], c[1], c[2])];
+				}
+			}
+			T[m] = ((2.0*degree - 1) * sum1 - (degree - 1.0) * sum2) / (degree * r2);
+		}
+
+		// C[j][k] = sum_a M_{j,a} (a_k + 1) T_{a + e_k}, B_i = eps_ijk C[j][k]
+		double C[3][3] = {}, L[3][3] = {};
+		const std::size_t first_last = position(order, 0, 0);
+		const std::size_t n = nr_moments();
+		for(std::size_t m = 0; m < n; m++) {
+			const std::array<unsigned, 3>& a = indices[m];
+			const double t[3] = {(a[0] + 1) * T[position(a[0] + 1, a[1], a[2])],
+			                     (a[1] + 1) * T[position(a[0], a[1] + 1, a[2])],
+			                     (a[2] + 1) * T[position(a[0], a[1], a[2] + 1)]};
+			double (&target)[3][3] = m >= first_last ? L : C;
+			for(unsigned j = 0; j < 3; j++)
+				for(unsigned k = 0; k < 3; k++)
+					target[j][k] += moments[3*m + j] * t[k];
+		}
+		last[0] = L[1][2] - L[2][1];
+		last[1] = L[2][0] - L[0][2];
+		last[2] = L[0][1] - L[1][0];
+		b[0] = C[1][2] - C[2][1] + last[0];
+		b[1] = C[2][0] - C[0][2] + last[1];
+		b[2] = C[0][1] - C[1][0] + last[2];
+	}
+};
+
+
+// Far field expansion of the Biot-Savart integral of a whole curve around
+// the centre of its bounding box, see TaylorTable. The moments are computed
+// once by Gauss-Legendre quadrature along the curve.
+//
+// Results are in the same (unscaled) units as the quadrature in biot_savart.
+class MultipoleExpansion {
+private:
+	std::array<double, 3> centre;
+	double radius;                          // of the bounding sphere
+	double min_distance;                    // in units of radius
+	double rel_error, abs_error;
+	TaylorTable table;
+	std::vector<double> moments;
+
+	static unsigned order_for(double rel_error, double min_distance, unsigned max_order)
+	{
+		return std::min(max_order, static_cast<unsigned>(
+			std::ceil(std::log(rel_error) / std::log(1.0 / min_distance))));
+	}
+
+public:
+	// The truncation order is the smallest one for which (1 / min_distance_)^order
+	// is below rel_error_, capped at max_order. Points closer than
+	// min_distance_ * radius to the centre are not covered.
+	template<class CurveType>
+	MultipoleExpansion(const CurveType& curve, double rel_error_, double abs_error_,
+	                   double min_distance_, unsigned max_order)
+		: min_distance{min_distance_}, rel_error{rel_error_}, abs_error{abs_error_},
+		  table{order_for(rel_error_, min_distance_, max_order)}
+	{
+		// Gauss-Legendre nodes on panels of at most 1/16 of a turn, not
+		// crossing the kinks of the curve
+		std::vector<double> pieces = curve.breakpoints();
+		if(pieces.empty()) pieces = {- curve.period/2, curve.period/2};
+		const std::size_t nr_nodes = 16;
+		gsl_integration_glfixed_table* gl = gsl_integration_glfixed_table_alloc(nr_nodes);
+		std::vector<double> ts, ws;
+		for(std::size_t piece = 0; piece + 1 < pieces.size(); piece++) {
+			const double length = pieces[piece + 1] - pieces[piece];
+			const std::size_t nr_panels = static_cast<std::size_t>(std::ceil(length / (M_PI / 8)));
+			const double panel = length / nr_panels;
+			for(std::size_t p = 0; p < nr_panels; p++) {
+				const double a = pieces[piece] + p * panel;
+				for(std::size_t i = 0; i < nr_nodes; i++) {
+					double t, w;
+					gsl_integration_glfixed_point(a, a + panel, i, &t, &w, gl);
+					ts.push_back(t);
+					ws.push_back(w);
+				}
+			}
+		}
+		gsl_integration_glfixed_table_free(gl);
+
+		std::array<double, 3> lo{{HUGE_VAL, HUGE_VAL, HUGE_VAL}};
+		std::array<double, 3> hi{{-HUGE_VAL, -HUGE_VAL, -HUGE_VAL}};
+		for(double t : ts) {
+			const vector3D x = curve.parametrize(t);
+			const double c[3] = {get<0>(x), get<1>(x), get<2>(x)};
+			for(unsigned i = 0; i < 3; i++) {
+				lo[i] = std::min(lo[i], c[i]);
+				hi[i] = std::max(hi[i], c[i]);
+			}
+		}
+		for(unsigned i = 0; i < 3; i++) centre[i] = (lo[i] + hi[i]) / 2;
+		radius = 0;
+
+		moments.assign(3 * table.nr_moments(), 0);
+		for(std::size_t node = 0; node < ts.size(); node++) {
+			const vector3D x = curve.parametrize(ts[node]);
+			const vector3D dl = curve.diff_el(ts[node]);
+			const double s[3] = {get<0>(x) - centre[0], get<1>(x) - centre[1], get<2>(x) - centre[2]};
+			const double w[3] = {curve.current * ws[node] * get<0>(dl),
+			                     curve.current * ws[node] * get<1>(dl),
+			                     curve.current * ws[node] * get<2>(dl)};
+			radius = std::max(radius, std::sqrt(s[0]*s[0] + s[1]*s[1] + s[2]*s[2]));
+			table.accumulate(s, w, moments.data());
+		}
+		radius += curve.wireR;
+	}
+
+	bool covers(const vector3D& point) const noexcept
+	{
+		const double dx = get<0>(point) - centre[0];
+		const double dy = get<1>(point) - centre[1];
+		const double dz = get<2>(point) - centre[2];
+		return std::sqrt(dx*dx + dy*dy + dz*dz) >= min_distance * radius;
+	}
+
+	unsigned get_order() const noexcept { return table.get_order(); }
+	double get_radius() const noexcept { return radius; }
+
+	// Evaluates the truncated series at a covered point. The error is
+	// estimated as the terms of the highest order times the tail of the
+	// geometric series. Returns false, leaving field untouched, if that
+	// estimate does not meet the tolerances.
+	bool evaluate(const vector3D& point, std::tuple<vector3D, vector3D>& field) const
+	{
+		const double R[3] = {get<0>(point) - centre[0], get<1>(point) - centre[1], get<2>(point) - centre[2]};
+		double b[3], last[3];
+		table.field(moments.data(), R, b, last);
+
+		const double ratio = radius / std::sqrt(R[0]*R[0] + R[1]*R[1] + R[2]*R[2]);
+		const double tail = ratio / (1 - ratio);
+		vector3D result{b[0], b[1], b[2]};
+		vector3D err{tail * std::abs(last[0]), tail * std::abs(last[1]), tail * std::abs(last[2])};
+		if(err.length() > std::max(abs_error, rel_error * result.length()))
+			return false;
+		field = std::tuple<vector3D, vector3D>(std::move(result), std::move(err));
+		return true;
+	}
+};
+
+#endif // MULTIPOLE_H
@@ -0,0 +1,245 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+extern "C" {
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+}
+
+#include "field_configure.h"
+
+
+// Hardware counters of the calling thread (perf_event_open), added up per
+// region of the code and per thread. The events of a thread form one group,
+// so a region costs two read() calls. Events the kernel or the machine does
+// not provide (virtual machines often have no PMU) are left out and reported
+// as null; the floating point event is model specific and only counted when
+// FIELD_PERF_FP_OPS_EVENT is set. Everything compiles away unless
+// FIELD_PERF_COUNTERS is set in field_configure.h.
+namespace perf {
+
+	enum Region { QUADRATURE, GRID, WRITE, NR_REGIONS };
+	const char* const region_names[NR_REGIONS] = {"quadrature", "grid", "write"};
+
+	enum Event { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, FP_OPS, TASK_CLOCK, NR_EVENTS };
+	const char* const event_names[NR_EVENTS] = {"cycles", "instructions", "cache_misses", "branch_misses",
+	                                            "fp_ops", "task_clock_ns"};
+
+	namespace detail {
+
+		inline bool event_attr(Event event, perf_event_attr& attr)
+		{
+			std::memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			switch(event) {
+				case CYCLES: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+				case INSTRUCTIONS: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+				case CACHE_MISSES: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+				case BRANCH_MISSES: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+				case FP_OPS:
+					if(FIELD_PERF_FP_OPS_EVENT == 0) return false;
+					attr.type = PERF_TYPE_RAW;
+					attr.config = FIELD_PERF_FP_OPS_EVENT;
+					break;
+				case TASK_CLOCK:
+					attr.type = PERF_TYPE_SOFTWARE;
+					attr.config = PERF_COUNT_SW_TASK_CLOCK;
+					break;
+				default: return false;
+			}
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			return true;
+		}
+
+	}
+
+	// Counter group of one thread and its totals per region.
+	class ThreadCounters {
+	private:
+		std::vector<int> fds;                           // the first one leads the group
+		std::vector<Event> events;                      // counted by fds
+		// raw counts, and the time the group was enabled and running: the
+		// kernel multiplexes groups if there are more than counters
+		std::atomic<std::uint64_t> counts[NR_REGIONS][NR_EVENTS];
+		std::atomic<std::uint64_t> enabled[NR_REGIONS], running[NR_REGIONS];
+
+	public:
+		// Values of one read: time enabled, time running, then the counts.
+		using Snapshot = std::uint64_t[2 + NR_EVENTS];
+
+		ThreadCounters()
+		{
+			for(unsigned r = 0; r < NR_REGIONS; r++) {
+				for(unsigned e = 0; e < NR_EVENTS; e++) counts[r][e] = 0;
+				enabled[r] = 0;
+				running[r] = 0;
+			}
+			for(unsigned e = 0; e < NR_EVENTS; e++) {
+				perf_event_attr attr;
+				if(!detail::event_attr(static_cast<Event>(e), attr)) continue;
+				const int leader = fds.empty() ? -1 : fds.front();
+				const int fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+				if(fd < 0) continue;
+				fds.push_back(fd);
+				events.push_back(static_cast<Event>(e));
+			}
+		}
+
+		~ThreadCounters()
+		{
+			for(int fd : fds) ::close(fd);
+		}
+
+		ThreadCounters(const ThreadCounters&) =delete;
+		ThreadCounters& operator=(const ThreadCounters&) =delete;
+
+		bool counts_event(Event event) const
+		{
+			for(Event e : events) {
+				if(e == event) return true;
+			}
+			return false;
+		}
+
+		// false if no event could be opened
+		bool read(Snapshot& snapshot) const noexcept
+		{
+			if(fds.empty()) return false;
+			std::uint64_t buffer[3 + NR_EVENTS];
+			if(::read(fds.front(), buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + events.size()) * sizeof(std::uint64_t)))
+				return false;
+			snapshot[0] = buffer[1];
+			snapshot[1] = buffer[2];
+			for(std::size_t i = 0; i < events.size(); i++) snapshot[2 + i] = buffer[3 + i];
+			return true;
+		}
+
+		// adds end - start to region; only called by the owning thread
+		void add(Region region, const Snapshot& start, const Snapshot& end) noexcept
+		{
+			auto add = [](std::atomic<std::uint64_t>& counter, std::uint64_t n) {
+				counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+			};
+			add(enabled[region], end[0] - start[0]);
+			add(running[region], end[1] - start[1]);
+			for(std::size_t i = 0; i < events.size(); i++) add(counts[region][events[i]], end[2 + i] - start[2 + i]);
+		}
+
+		// count of event in region, scaled up for the time the group was not
+		// scheduled
+		double count(Region region, Event event) const
+		{
+			const std::uint64_t run = running[region].load();
+			if(run == 0) return 0;
+			return counts[region][event].load() * (static_cast<double>(enabled[region].load()) / run);
+		}
+	};
+
+	class Registry {
+	private:
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadCounters>> threads;   // in the order of their first region
+
+		void write_region(std::ostream& out, const ThreadCounters& first, Region region, const double values[NR_EVENTS])
+		{
+			out << "\"" << region_names[region] << "\": {";
+			for(unsigned e = 0; e < NR_EVENTS; e++) {
+				out << (e > 0 ? ", " : "") << "\"" << event_names[e] << "\": ";
+				if(first.counts_event(static_cast<Event>(e))) out << static_cast<std::uint64_t>(values[e]);
+				else out << "null";
+			}
+			out << "}";
+		}
+
+	public:
+		ThreadCounters& add_thread()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			threads.emplace_back(new ThreadCounters);
+			return *threads.back();
+		}
+
+		// {"threads": [{"thread": i, region: {event: count, ...}, ...}, ...],
+		// "total": {region: {...}, ...}}; events that are not counted are null
+		void write_json(std::ostream& out, const char* indent)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(threads.empty()) {
+				out << "{}";
+				return;
+			}
+			const ThreadCounters& first = *threads.front();
+			double total[NR_REGIONS][NR_EVENTS] = {};
+			out << "{\n" << indent << "\t\"threads\": [";
+			for(std::size_t t = 0; t < threads.size(); t++) {
+				out << (t > 0 ? "," : "") << "\n" << indent << "\t\t{\"thread\": " << t;
+				for(unsigned r = 0; r < NR_REGIONS; r++) {
+					double values[NR_EVENTS];
+					for(unsigned e = 0; e < NR_EVENTS; e++) {
+						values[e] = threads[t]->count(static_cast<Region>(r), static_cast<Event>(e));
+						total[r][e] += values[e];
+					}
+					out << ", ";
+					write_region(out, first, static_cast<Region>(r), values);
+				}
+				out << "}";
+			}
+			out << "\n" << indent << "\t],\n" << indent << "\t\"total\": {";
+			for(unsigned r = 0; r < NR_REGIONS; r++) {
+				out << (r > 0 ? ", " : "");
+				write_region(out, first, static_cast<Region>(r), total[r]);
+			}
+			out << "}\n" << indent << "}";
+		}
+	};
+
+	inline Registry& registry()
+	{
+		static Registry instance;
+		return instance;
+	}
+
+	// counter group of the calling thread
+	inline ThreadCounters& counters()
+	{
+		static thread_local ThreadCounters& mine = registry().add_thread();
+		return mine;
+	}
+
+	// Adds the counts between construction and destruction to the region.
+	class Scope {
+	private:
+		const Region region;
+		ThreadCounters::Snapshot start;
+		bool started;
+
+	public:
+		explicit Scope(Region region_) noexcept : region{region_}, started{FIELD_PERF_COUNTERS && counters().read(start)} {}
+
+		Scope(const Scope&) =delete;
+		Scope& operator=(const Scope&) =delete;
+
+		~Scope()
+		{
+			if(!FIELD_PERF_COUNTERS || !started) return;
+			ThreadCounters::Snapshot end;
+			if(counters().read(end)) counters().add(region, start, end);
+		}
+	};
+
+}
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,143 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+
+// Progress of a computation over a known number of points, fed by any number
+// of worker threads through atomic counters and printed by a timer thread
+// every interval, so the workers never wait for the stream. Besides the
+// fraction of points done it shows the points and integrand evaluations per
+// second and an ETA. The ETA extrapolates the time spent on the estimated
+// cost of the points done to the estimated cost of all points, so expensive
+// regions (near the wire) late in the traversal do not make it too
+// optimistic.
+class Progress {
+private:
+	std::ostream& out;
+	const std::string label;
+	const std::uint64_t nr_points;
+	const double total_cost;
+	const std::chrono::steady_clock::time_point start;
+	std::atomic<std::uint64_t> points_done{0};
+	std::atomic<std::uint64_t> evaluations{0};
+	std::atomic<double> cost_done{0};
+	std::mutex mutex;                       // guards out and stopping
+	std::condition_variable wake;
+	bool stopping;
+	std::thread timer;
+
+	double elapsed() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	static std::string format_duration(double seconds)
+	{
+		const long s = static_cast<long>(seconds + 0.5);
+		std::ostringstream text;
+		if(s >= 3600) text << s / 3600 << "h";
+		if(s >= 60) text << (s % 3600) / 60 << "m";
+		text << s % 60 << "s";
+		return text.str();
+	}
+
+	// the progress line, without the leading '\r'
+	std::string line() const
+	{
+		const double seconds = elapsed();
+		const std::uint64_t points = points_done.load(std::memory_order_relaxed);
+		const double cost = cost_done.load(std::memory_order_relaxed);
+		std::ostringstream text;
+		text.precision(3);
+		text << label << ": " << (nr_points == 0 ? 100 : 100 * points / nr_points) << "%";
+		if(seconds > 0 && points > 0) {
+			text << " | " << points / seconds << " points/s | "
+			     << evaluations.load(std::memory_order_relaxed) / seconds << " evals/s";
+			if(cost > 0 && total_cost > cost)
+				text << " | ETA " << format_duration(seconds * (total_cost - cost) / cost);
+		}
+		return text.str();
+	}
+
+	void print_line()
+	{
+		const std::string text = line();
+		out << '\r' << text << "    " << std::flush;   // the spaces clear a longer previous line
+	}
+
+public:
+	// total_cost is the sum of the cost estimates of all nr_points points,
+	// in the units passed to add(). interval_ms = 0 prints only at the end.
+	Progress(std::ostream& out_, std::string label_, std::uint64_t nr_points_, double total_cost_,
+	         unsigned interval_ms)
+		: out(out_), label(std::move(label_)), nr_points{nr_points_}, total_cost{total_cost_},
+		  start{std::chrono::steady_clock::now()}, stopping{false}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		print_line();
+		if(interval_ms == 0) return;
+		timer = std::thread([this, interval_ms]() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while(!wake.wait_for(lock, std::chrono::milliseconds(interval_ms), [this]() { return stopping; }))
+				print_line();
+		});
+	}
+
+	Progress(const Progress&) =delete;
+	Progress& operator=(const Progress&) =delete;
+
+	~Progress()
+	{
+		finish();
+	}
+
+	// nr points of estimated cost done with nr_evaluations integrand calls;
+	// lock free, callable from any thread
+	void add(std::uint64_t nr, double cost, std::uint64_t nr_evaluations) noexcept
+	{
+		points_done.fetch_add(nr, std::memory_order_relaxed);
+		evaluations.fetch_add(nr_evaluations, std::memory_order_relaxed);
+		double old = cost_done.load(std::memory_order_relaxed);
+		while(!cost_done.compare_exchange_weak(old, old + cost, std::memory_order_relaxed)) {}
+	}
+
+	// prints text on a line of its own, the progress line below it
+	void message(const std::string& text)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		out << '\r' << text << "\n";
+		print_line();
+	}
+
+	// stops the timer and ends the line with the totals; called by the
+	// destructor if not before
+	void finish()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(stopping) return;
+			stopping = true;
+		}
+		wake.notify_all();
+		if(timer.joinable()) timer.join();
+		const double seconds = elapsed();
+		std::ostringstream text;
+		text.precision(3);
+		text << label << ": 100% (" << points_done.load() << " points in " << seconds << " s";
+		if(seconds > 0)
+			text << ", " << points_done.load() / seconds << " points/s, " << evaluations.load() / seconds << " evals/s";
+		text << ").";
+		out << '\r' << text.str() << "    \n" << std::flush;
+	}
+};
+
+#endif // PROGRESS_H
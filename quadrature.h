@@ -0,0 +1,131 @@
+#ifndef QUADRATURE_H
+#define QUADRATURE_H
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+	#include <gsl/gsl_integration.h>
+}
+
+#include "field_configure.h"
+
+
+// Rules besides the Gauss-Kronrod ones of qag (GSL_INTEG_GAUSS15 to
+// GSL_INTEG_GAUSS61): qags, which extrapolates over endpoint singularities,
+// and cquad, the doubly adaptive Clenshaw-Curtis rule.
+enum { QUADRATURE_QAGS = GSL_INTEG_GAUSS61 + 1, QUADRATURE_CQUAD };
+
+// Tolerances, rule (one of the GSL_INTEG_GAUSS* keys or QUADRATURE_QAGS,
+// QUADRATURE_CQUAD) and interval limit of the adaptive quadrature in
+// biot_savart. The integral is refined until its error is below
+// max(abs_error, rel_error |result|).
+struct QuadratureSettings {
+	double rel_error;
+	double abs_error;
+	int key;
+	std::size_t limit;
+};
+
+// Settings for the points whose distance to the wire of a conductor lies in
+// [min_distance, max_distance).
+struct QuadratureRegion {
+	double min_distance, max_distance;
+	QuadratureSettings settings;
+};
+
+// Quadrature settings of a scene: the defaults and overrides by distance to
+// the wire, e.g. a tighter tolerance near the wire and a looser one in the far
+// field. With scaled_abs_error every abs_error is relative to the magnitude
+// of the integrand at the point (the sum of |dB| along the curve, see
+// CurveSamples) instead of being in the units of the integrand, so it means
+// the same for every current and geometry.
+struct Quadrature {
+	QuadratureSettings defaults;
+	std::vector<QuadratureRegion> regions;   // the first one containing the distance applies
+	bool scaled_abs_error;
+
+	Quadrature() : defaults{FIELD_REL_ERROR, FIELD_ABS_ERROR, FIELD_KEY, FIELD_LIMIT}, scaled_abs_error{FIELD_ABS_ERROR_SCALED} {}
+
+	const QuadratureSettings& at(double distance) const noexcept
+	{
+		for(const QuadratureRegion& region : regions) {
+			if(distance >= region.min_distance && distance < region.max_distance) return region.settings;
+		}
+		return defaults;
+	}
+
+	// true if the settings depend on the point
+	bool local() const noexcept { return scaled_abs_error || !regions.empty(); }
+
+	// the number of intervals a workspace must hold
+	std::size_t max_limit() const noexcept
+	{
+		std::size_t limit = defaults.limit;
+		for(const QuadratureRegion& region : regions) limit = std::max(limit, region.settings.limit);
+		return limit;
+	}
+
+	// all settings, as text (for cache tags)
+	std::string description() const
+	{
+		std::ostringstream out;
+		out.precision(17);
+		out << scaled_abs_error;
+		auto write = [&out](const QuadratureSettings& s) {
+			out << ' ' << s.rel_error << ' ' << s.abs_error << ' ' << s.key << ' ' << s.limit;
+		};
+		write(defaults);
+		for(const QuadratureRegion& region : regions) {
+			out << " [" << region.min_distance << ' ' << region.max_distance;
+			write(region.settings);
+			out << ']';
+		}
+		return out.str();
+	}
+};
+
+// GSL_INTEG_GAUSS* key of the Gauss-Kronrod rule with nr_points points, 0 if
+// there is none
+inline int gauss_kronrod_key(int nr_points)
+{
+	switch(nr_points) {
+		case 15: return GSL_INTEG_GAUSS15;
+		case 21: return GSL_INTEG_GAUSS21;
+		case 31: return GSL_INTEG_GAUSS31;
+		case 41: return GSL_INTEG_GAUSS41;
+		case 51: return GSL_INTEG_GAUSS51;
+		case 61: return GSL_INTEG_GAUSS61;
+		default: return 0;
+	}
+}
+
+inline bool is_gauss_kronrod(int key) noexcept
+{
+	return key >= GSL_INTEG_GAUSS15 && key <= GSL_INTEG_GAUSS61;
+}
+
+// "GK15" ... "GK61", "QAGS" or "CQUAD"
+inline std::string rule_name(int key)
+{
+	static const char* const names[] = {"GK15", "GK21", "GK31", "GK41", "GK51", "GK61", "QAGS", "CQUAD"};
+	if(key < GSL_INTEG_GAUSS15 || key > QUADRATURE_CQUAD) return "?";
+	return names[key - GSL_INTEG_GAUSS15];
+}
+
+// key of a rule given by its name (see rule_name) or as the number of points
+// of a Gauss-Kronrod rule; 0 if there is none
+inline int rule_key(const std::string& name)
+{
+	for(int key = GSL_INTEG_GAUSS15; key <= QUADRATURE_CQUAD; key++) {
+		if(name == rule_name(key)) return key;
+	}
+	std::istringstream in(name);
+	int nr_points = 0;
+	if(!(in >> nr_points) || !in.eof()) return 0;
+	return gauss_kronrod_key(nr_points);
+}
+
+#endif // QUADRATURE_H
@@ -0,0 +1,126 @@
+#ifndef SPACE_FILLING_H
+#define SPACE_FILLING_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+
+// Orderings of points along space filling curves: points that are close in
+// such an order are also close in space, which keeps the data touched by
+// consecutive evaluations (caches, quadrature partitions) relevant.
+
+namespace space_filling_detail {
+
+	// the lower 21 bits of v, each followed by two zero bits
+	inline std::uint64_t spread(std::uint64_t v) noexcept
+	{
+		v &= 0x1fffff;
+		v = (v | v << 32) & 0x1f00000000ffffULL;
+		v = (v | v << 16) & 0x1f0000ff0000ffULL;
+		v = (v | v << 8) & 0x100f00f00f00f00fULL;
+		v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+		v = (v | v << 2) & 0x1249249249249249ULL;
+		return v;
+	}
+
+}
+
+// Morton (Z order) key of x on a grid of 2^21 cells per axis over [lo, hi];
+// axes with lo == hi are ignored.
+inline std::uint64_t morton_key(const std::array<double, 3>& x, const std::array<double, 3>& lo,
+                                const std::array<double, 3>& hi) noexcept
+{
+	const double cells = 1 << 21;
+	std::uint64_t key = 0;
+	for(unsigned axis = 0; axis < 3; axis++) {
+		if(!(hi[axis] > lo[axis])) continue;
+		const double t = (x[axis] - lo[axis]) / (hi[axis] - lo[axis]) * cells;
+		const std::uint64_t cell = static_cast<std::uint64_t>(std::min(std::max(t, 0.0), cells - 1));
+		key |= space_filling_detail::spread(cell) << (2 - axis);
+	}
+	return key;
+}
+
+// Indices of the points ordered along the Morton curve over their bounding box.
+inline std::vector<std::size_t> morton_order(const std::vector<std::array<double, 3>>& points)
+{
+	std::array<double, 3> lo{{0, 0, 0}}, hi{{0, 0, 0}};
+	if(!points.empty()) lo = hi = points.front();
+	for(const std::array<double, 3>& x : points) {
+		for(unsigned axis = 0; axis < 3; axis++) {
+			lo[axis] = std::min(lo[axis], x[axis]);
+			hi[axis] = std::max(hi[axis], x[axis]);
+		}
+	}
+
+	std::vector<std::pair<std::uint64_t, std::size_t>> keys(points.size());
+	for(std::size_t i = 0; i < points.size(); i++) keys[i] = std::make_pair(morton_key(points[i], lo, hi), i);
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<std::size_t> order(points.size());
+	for(std::size_t i = 0; i < points.size(); i++) order[i] = keys[i].second;
+	return order;
+}
+
+// Hilbert key of the cell x on a grid of 2^bits cells per axis (bits <= 21),
+// following J. Skilling, "Programming the Hilbert curve" (2004). Cells with
+// consecutive keys are face neighbours.
+inline std::uint64_t hilbert_key(std::array<std::uint32_t, 3> x, unsigned bits) noexcept
+{
+	const std::uint32_t m = 1u << (bits - 1);
+	for(std::uint32_t q = m; q > 1; q >>= 1) {
+		const std::uint32_t p = q - 1;
+		for(unsigned i = 0; i < 3; i++) {
+			if(x[i] & q) {
+				x[0] ^= p;
+			} else {
+				const std::uint32_t t = (x[0] ^ x[i]) & p;
+				x[0] ^= t;
+				x[i] ^= t;
+			}
+		}
+	}
+	for(unsigned i = 1; i < 3; i++) x[i] ^= x[i-1];
+	std::uint32_t t = 0;
+	for(std::uint32_t q = m; q > 1; q >>= 1) {
+		if(x[2] & q) t ^= q - 1;
+	}
+	for(unsigned i = 0; i < 3; i++) x[i] ^= t;
+
+	// interleave the bits of the transposed key, most significant first
+	std::uint64_t key = 0;
+	for(int b = bits - 1; b >= 0; b--) {
+		for(unsigned i = 0; i < 3; i++) key = key << 1 | (x[i] >> b & 1);
+	}
+	return key;
+}
+
+// Cells of an n[0] x n[1] x n[2] block ordered along the Hilbert curve of the
+// smallest power of 2 cube containing it.
+inline std::vector<std::array<std::size_t, 3>> hilbert_order(const std::array<std::size_t, 3>& n)
+{
+	unsigned bits = 1;
+	while((std::size_t(1) << bits) < std::max(n[0], std::max(n[1], n[2]))) bits++;
+
+	std::vector<std::pair<std::uint64_t, std::array<std::size_t, 3>>> keys;
+	keys.reserve(n[0] * n[1] * n[2]);
+	for(std::size_t i = 0; i < n[0]; i++) {
+		for(std::size_t j = 0; j < n[1]; j++) {
+			for(std::size_t k = 0; k < n[2]; k++) {
+				const std::array<std::uint32_t, 3> cell{{static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(j),
+				                                         static_cast<std::uint32_t>(k)}};
+				keys.push_back(std::make_pair(hilbert_key(cell, bits), std::array<std::size_t, 3>{{i, j, k}}));
+			}
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<std::array<std::size_t, 3>> order(keys.size());
+	for(std::size_t i = 0; i < keys.size(); i++) order[i] = keys[i].second;
+	return order;
+}
+
+#endif // SPACE_FILLING_H
@@ -0,0 +1,161 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "perf_counters.h"
+#include "field_configure.h"
+
+
+// Run statistics: wall time of the phases of a run and counters of the work
+// done, kept per thread so that counting needs no synchronization. Every
+// counter has a single writer (its thread), the atomics only make reading
+// them from another thread well defined.
+namespace statistics {
+
+	struct Counters {
+		std::atomic<std::uint64_t> integrand_calls{0};
+		std::atomic<std::uint64_t> subintervals{0};     // used by the adaptive quadratures
+		std::atomic<std::uint64_t> limit_hits{0};       // integrals that ran into FIELD_LIMIT subintervals
+		std::atomic<std::uint64_t> bytes_written{0};
+	};
+
+	// increment by the thread owning counter
+	inline void add(std::atomic<std::uint64_t>& counter, std::uint64_t n = 1) noexcept
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	class Registry {
+	private:
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Counters>> threads;   // in the order of their first count
+		std::vector<std::pair<std::string, double>> phases;
+
+	public:
+		Counters& add_thread()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			threads.emplace_back(new Counters);
+			return *threads.back();
+		}
+
+		void add_phase(const std::string& name, double seconds)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for(std::pair<std::string, double>& phase : phases) {
+				if(phase.first == name) {
+					phase.second += seconds;
+					return;
+				}
+			}
+			phases.emplace_back(name, seconds);
+		}
+
+		// {"phases": {name: seconds, ...}, "threads": [counters, ...], "total": counters},
+		// with FIELD_PERF_COUNTERS also "perf": the hardware counters (see perf::Registry)
+		void write_json(std::ostream& out)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			out << "{\n\t\"phases\": {";
+			for(std::size_t i = 0; i < phases.size(); i++)
+				out << (i > 0 ? "," : "") << "\n\t\t\"" << phases[i].first << "\": " << phases[i].second;
+			out << "\n\t},\n\t\"threads\": [";
+			std::uint64_t total[4] = {0, 0, 0, 0};
+			for(std::size_t i = 0; i < threads.size(); i++) {
+				const std::uint64_t values[4] = {threads[i]->integrand_calls.load(), threads[i]->subintervals.load(),
+				                                 threads[i]->limit_hits.load(), threads[i]->bytes_written.load()};
+				out << (i > 0 ? "," : "") << "\n\t\t{\"thread\": " << i;
+				write_counters(out, values);
+				out << "}";
+				for(unsigned k = 0; k < 4; k++) total[k] += values[k];
+			}
+			out << "\n\t],\n\t\"total\": {\"threads\": " << threads.size();
+			write_counters(out, total);
+			out << "}";
+			if(FIELD_PERF_COUNTERS) {
+				out << ",\n\t\"perf\": ";
+				perf::registry().write_json(out, "\t");
+			}
+			out << "\n}\n";
+		}
+
+	private:
+		static void write_counters(std::ostream& out, const std::uint64_t values[4])
+		{
+			out << ", \"integrand_calls\": " << values[0] << ", \"subintervals\": " << values[1]
+			    << ", \"limit_hits\": " << values[2] << ", \"bytes_written\": " << values[3];
+		}
+	};
+
+	inline Registry& registry()
+	{
+		static Registry instance;
+		return instance;
+	}
+
+	// counters of the calling thread
+	inline Counters& counters()
+	{
+		static thread_local Counters& mine = registry().add_thread();
+		return mine;
+	}
+
+	// Adds the wall time between construction and destruction to the phase.
+	class Phase {
+	private:
+		const std::string name;
+		const std::chrono::steady_clock::time_point start;
+
+	public:
+		explicit Phase(std::string name_) : name(std::move(name_)), start{std::chrono::steady_clock::now()} {}
+
+		Phase(const Phase&) =delete;
+		Phase& operator=(const Phase&) =delete;
+
+		~Phase()
+		{
+			registry().add_phase(name, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+	};
+
+	// result of f(), adding its wall time to the phase
+	template<class Function>
+	auto timed(const std::string& name, Function f) -> decltype(f())
+	{
+		const Phase phase(name);
+		return f();
+	}
+
+	// Writes the JSON report to path when destroyed, i.e. at the end of the
+	// scope of the run; an empty path writes nothing.
+	class Report {
+	private:
+		const std::string path;
+
+	public:
+		explicit Report(std::string path_) : path(std::move(path_)) {}
+
+		Report(const Report&) =delete;
+		Report& operator=(const Report&) =delete;
+
+		~Report()
+		{
+			if(path.empty()) return;
+			std::ofstream out(path);
+			registry().write_json(out);
+		}
+	};
+
+}
+
+#endif // STATISTICS_H
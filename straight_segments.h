@@ -0,0 +1,54 @@
+#ifndef STRAIGHT_SEGMENTS_H
+#define STRAIGHT_SEGMENTS_H
+
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+
+
+// Sum of the Biot-Savart fields of the straight segments (a_i, b_i),
+// i < n, at the point p, in units of the integrand (current 1, no mu0/4pi).
+// With r1 = p - a and r2 = p - b the field of one segment is
+//
+//     (r1 x r2) (|r1| + |r2|) / (|r1| |r2| (|r1| |r2| + r1.r2)),
+//
+// scaled by d^2/wireR^2 when the distance d to the segment's line is below
+// wireR, as in integrand(). The loop is kept free of branches so that it
+// vectorizes. b receives the field and err a bound on the accumulated
+// rounding error.
+inline void straight_segments_field(const double* ax, const double* ay, const double* az,
+                                    const double* bx, const double* by, const double* bz,
+                                    std::size_t n, const double p[3], double wireR,
+                                    double b[3], double err[3]) noexcept
+{
+	const double w2 = wireR * wireR;
+	double sx = 0, sy = 0, sz = 0;
+	double ex = 0, ey = 0, ez = 0;
+	for(std::size_t i = 0; i < n; i++) {
+		const double r1x = p[0] - ax[i], r1y = p[1] - ay[i], r1z = p[2] - az[i];
+		const double r2x = p[0] - bx[i], r2y = p[1] - by[i], r2z = p[2] - bz[i];
+		const double lx = bx[i] - ax[i], ly = by[i] - ay[i], lz = bz[i] - az[i];
+		const double l1 = std::sqrt(r1x*r1x + r1y*r1y + r1z*r1z);
+		const double l2 = std::sqrt(r2x*r2x + r2y*r2y + r2z*r2z);
+		const double cx = r1y*r2z - r1z*r2y;
+		const double cy = r1z*r2x - r1x*r2z;
+		const double cz = r1x*r2y - r1y*r2x;
+		const double d2 = (cx*cx + cy*cy + cz*cz) / (lx*lx + ly*ly + lz*lz);
+		const double denom = l1 * l2 * (l1 * l2 + r1x*r2x + r1y*r2y + r1z*r2z);
+		const double f = (denom > 0 ? (l1 + l2) / denom : 0) * (d2 < w2 ? d2 / w2 : 1);
+		sx += f * cx;
+		sy += f * cy;
+		sz += f * cz;
+		ex += std::abs(f * cx);
+		ey += std::abs(f * cy);
+		ez += std::abs(f * cz);
+	}
+	b[0] = sx;
+	b[1] = sy;
+	b[2] = sz;
+	err[0] = 16 * DBL_EPSILON * ex;
+	err[1] = 16 * DBL_EPSILON * ey;
+	err[2] = 16 * DBL_EPSILON * ez;
+}
+
+#endif // STRAIGHT_SEGMENTS_H
@@ -0,0 +1,98 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+// Fixed set of worker threads executing submitted tasks. Tasks with higher
+// priority are started first, tasks of equal priority in the order they were
+// submitted. Tasks must not throw.
+class ThreadPool {
+private:
+	struct Task {
+		double priority;
+		std::size_t sequence;
+		std::function<void()> function;
+
+		bool operator<(const Task& other) const noexcept
+		{
+			return priority < other.priority 
+			    || (priority == other.priority && sequence > other.sequence);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	std::priority_queue<Task> tasks;
+	std::size_t nr_submitted;
+	std::mutex mutex;
+	std::condition_variable available;   // a task was submitted or the pool stops
+	std::condition_variable finished;    // a task was completed
+	std::size_t nr_busy;
+	bool stopping;
+
+	void work()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while(true) {
+			available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if(tasks.empty()) return;
+			std::function<void()> task = tasks.top().function;
+			tasks.pop();
+			nr_busy++;
+			lock.unlock();
+			task();
+			lock.lock();
+			nr_busy--;
+			finished.notify_all();
+		}
+	}
+
+public:
+	// nr_threads == 0 uses one thread per hardware thread
+	explicit ThreadPool(std::size_t nr_threads = 0) : nr_submitted{0}, nr_busy{0}, stopping{false}
+	{
+		if(nr_threads == 0) nr_threads = std::max(1u, std::thread::hardware_concurrency());
+		for(std::size_t i = 0; i < nr_threads; i++)
+			workers.emplace_back(&ThreadPool::work, this);
+	}
+
+	ThreadPool(const ThreadPool&) =delete;
+	ThreadPool& operator=(const ThreadPool&) =delete;
+
+	// finishes the remaining tasks before joining the workers
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		available.notify_all();
+		for(std::thread& worker : workers) worker.join();
+	}
+
+	std::size_t size() const noexcept { return workers.size(); }
+
+	void submit(std::function<void()> task, double priority = 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push(Task{priority, nr_submitted++, std::move(task)});
+		}
+		available.notify_one();
+	}
+
+	// blocks until all submitted tasks are completed
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this]() { return tasks.empty() && nr_busy == 0; });
+	}
+};
+
+#endif // THREAD_POOL_H
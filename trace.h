@@ -0,0 +1,158 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "field_configure.h"
+
+
+// Timeline of what the threads are doing, written in the Chrome trace event
+// format (load it in chrome://tracing or ui.perfetto.dev). Every thread
+// records its events into a ring buffer of FIELD_TRACE_BUFFER_SIZE events of
+// its own, so tracing takes two clock reads and no lock; when a buffer is
+// full its oldest events are overwritten. Everything compiles away unless
+// FIELD_TRACE is set in field_configure.h.
+namespace trace {
+
+	struct Event {
+		const char* name;            // string literal
+		std::int64_t begin, end;     // ns since the start of the run
+	};
+
+	class Buffer {
+	private:
+		std::vector<Event> events;
+		std::uint64_t nr_events;     // ever recorded
+
+	public:
+		Buffer() : events(FIELD_TRACE_BUFFER_SIZE), nr_events{0} {}
+
+		void add(const char* name, std::int64_t begin, std::int64_t end) noexcept
+		{
+			Event& event = events[nr_events % events.size()];
+			event.name = name;
+			event.begin = begin;
+			event.end = end;
+			nr_events++;
+		}
+
+		// oldest first
+		template<class Function>
+		void for_each(Function f) const
+		{
+			const std::uint64_t first = nr_events > events.size() ? nr_events - events.size() : 0;
+			for(std::uint64_t n = first; n < nr_events; n++) f(events[n % events.size()]);
+		}
+
+		std::uint64_t dropped() const
+		{
+			return nr_events > events.size() ? nr_events - events.size() : 0;
+		}
+	};
+
+	class Registry {
+	private:
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Buffer>> threads;   // in the order of their first event
+		const std::chrono::steady_clock::time_point start;
+
+	public:
+		Registry() : start{std::chrono::steady_clock::now()} {}
+
+		Buffer& add_thread()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			threads.emplace_back(new Buffer);
+			return *threads.back();
+		}
+
+		std::int64_t now() const noexcept
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		// Must not run while other threads are tracing.
+		void write_json(std::ostream& out)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+			bool first = true;
+			for(std::size_t t = 0; t < threads.size(); t++) {
+				out << (first ? "" : ",") << "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t
+				    << ", \"args\": {\"name\": \"" << (t == 0 ? "main" : "thread " + std::to_string(t))
+				    << (threads[t]->dropped() > 0 ? " (" + std::to_string(threads[t]->dropped()) + " events dropped)" : "")
+				    << "\"}}";
+				first = false;
+				threads[t]->for_each([&out, t](const Event& event) {
+					out << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << t
+					    << ", \"ts\": " << event.begin / 1000. << ", \"dur\": " << (event.end - event.begin) / 1000. << "}";
+				});
+			}
+			out << "\n]}\n";
+		}
+	};
+
+	inline Registry& registry()
+	{
+		static Registry instance;
+		return instance;
+	}
+
+	// ring buffer of the calling thread
+	inline Buffer& buffer()
+	{
+		static thread_local Buffer& mine = registry().add_thread();
+		return mine;
+	}
+
+	// Records the time between construction and destruction as an event.
+	class Scope {
+	private:
+		const char* const name;
+		const std::int64_t begin;
+
+	public:
+		explicit Scope(const char* name_) noexcept : name(name_), begin{FIELD_TRACE ? registry().now() : 0} {}
+
+		Scope(const Scope&) =delete;
+		Scope& operator=(const Scope&) =delete;
+
+		~Scope()
+		{
+			if(FIELD_TRACE) buffer().add(name, begin, registry().now());
+		}
+	};
+
+	// Writes the trace to path when destroyed, i.e. after the threads are
+	// done; an empty path writes nothing.
+	class Report {
+	private:
+		const std::string path;
+
+	public:
+		explicit Report(std::string path_) : path(std::move(path_))
+		{
+			if(!path.empty()) buffer();   // the clock starts here, the calling thread is "main"
+		}
+
+		Report(const Report&) =delete;
+		Report& operator=(const Report&) =delete;
+
+		~Report()
+		{
+			if(path.empty()) return;
+			std::ofstream out(path);
+			registry().write_json(out);
+		}
+	};
+
+}
+
+#endif // TRACE_H
@@ -44,27 +44,27 @@ public:
 	friend double get(const vector3D& v) noexcept;
 };
 
-vector3D operator+(const vector3D& v, const vector3D& w) noexcept 
+inline vector3D operator+(const vector3D& v, const vector3D& w) noexcept 
 {
 	return vector3D(v.x + w.x, v.y + w.y, v.z + w.z); 
 }
 
-vector3D operator-(const vector3D& v, const vector3D& w) noexcept 
+inline vector3D operator-(const vector3D& v, const vector3D& w) noexcept 
 {
 	return vector3D(v.x - w.x, v.y - w.y, v.z - w.z); 
 }
 
-double operator*(const vector3D& v, const vector3D& w) noexcept 
+inline double operator*(const vector3D& v, const vector3D& w) noexcept 
 {
 	return v.x * w.x + v.y * w.y + v.z * w.z; 
 }
 
-vector3D operator*(const double c, const vector3D& w) noexcept 
+inline vector3D operator*(const double c, const vector3D& w) noexcept 
 {
 	return vector3D(c * w.x, c * w.y, c * w.z);
 }
 
-std::ostream& operator <<(std::ostream& out, const vector3D& point) 
+inline std::ostream& operator <<(std::ostream& out, const vector3D& point) 
 {
 	out << point.x << '\t' << point.y << '\t' << point.z;
 	return out;
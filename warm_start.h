@@ -0,0 +1,101 @@
+#ifndef WARM_START_H
+#define WARM_START_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+extern "C" {
+	#include <gsl/gsl_integration.h>
+}
+
+
+// Adaptive Gauss-Kronrod quadrature (bisection of the worst interval, as in
+// gsl_integration_qag) that starts from the partition of [a, b] reached by
+// the previous call instead of from [a, b] itself. For a sequence of nearby
+// points, e.g. along a field line, the partition usually needs no or little
+// refinement, which saves the evaluations of the intermediate levels.
+//
+// Neighbouring intervals whose errors were far below the tolerance are merged
+// before use, so the partition also coarsens again when the integrand
+// becomes smoother.
+class WarmStartIntegrator {
+private:
+	struct Interval {
+		double a, b;
+		double result, error;
+	};
+
+	std::vector<Interval> partition;
+	int key;
+
+	void rule(const gsl_function* f, Interval& interval) const
+	{
+		double resabs, resasc;
+		switch(key) {
+			case GSL_INTEG_GAUSS15: gsl_integration_qk15(f, interval.a, interval.b, &interval.result, &interval.error, &resabs, &resasc); break;
+			case GSL_INTEG_GAUSS21: gsl_integration_qk21(f, interval.a, interval.b, &interval.result, &interval.error, &resabs, &resasc); break;
+			case GSL_INTEG_GAUSS31: gsl_integration_qk31(f, interval.a, interval.b, &interval.result, &interval.error, &resabs, &resasc); break;
+			case GSL_INTEG_GAUSS51: gsl_integration_qk51(f, interval.a, interval.b, &interval.result, &interval.error, &resabs, &resasc); break;
+			case GSL_INTEG_GAUSS61: gsl_integration_qk61(f, interval.a, interval.b, &interval.result, &interval.error, &resabs, &resasc); break;
+			default: gsl_integration_qk41(f, interval.a, interval.b, &interval.result, &interval.error, &resabs, &resasc); break;
+		}
+	}
+
+public:
+	// key is one of the GSL_INTEG_GAUSS* rules
+	explicit WarmStartIntegrator(int key_ = GSL_INTEG_GAUSS41) : key{key_} {}
+
+	std::size_t size() const noexcept { return partition.size(); }
+
+	// the partition is kept, only the rule applied to its intervals changes
+	void set_key(int key_) noexcept { key = key_; }
+
+	// Integral of f over [a, b] to max(abs_error, rel_error |result|), using
+	// at most limit intervals; error receives the estimated error.
+	double integrate(const gsl_function* f, double a, double b, double abs_error, double rel_error,
+	                 std::size_t limit, double& error)
+	{
+		if(partition.empty() || partition.front().a != a || partition.back().b != b) {
+			partition.assign(1, Interval{a, b, 0, 0});
+		} else {
+			double previous_error = 0;
+			for(const Interval& interval : partition) previous_error += interval.error;
+			const double negligible = previous_error / (4 * partition.size());
+			std::vector<Interval> merged;
+			for(std::size_t i = 0; i < partition.size(); i++) {
+				if(i + 1 < partition.size() && partition[i].error + partition[i+1].error < negligible) {
+					merged.push_back(Interval{partition[i].a, partition[i+1].b, 0, 0});
+					i++;
+				} else {
+					merged.push_back(partition[i]);
+				}
+			}
+			partition.swap(merged);
+		}
+
+		double result = 0;
+		error = 0;
+		for(Interval& interval : partition) {
+			rule(f, interval);
+			result += interval.result;
+			error += interval.error;
+		}
+
+		while(error > std::max(abs_error, rel_error * std::abs(result)) && partition.size() < limit) {
+			auto worst = std::max_element(partition.begin(), partition.end(),
+				[](const Interval& x, const Interval& y) { return x.error < y.error; });
+			const double middle = (worst->a + worst->b) / 2;
+			Interval left{worst->a, middle, 0, 0}, right{middle, worst->b, 0, 0};
+			rule(f, left);
+			rule(f, right);
+			result += left.result + right.result - worst->result;
+			error += left.error + right.error - worst->error;
+			*worst = right;
+			partition.insert(worst, left);
+		}
+		return result;
+	}
+};
+
+#endif // WARM_START_H